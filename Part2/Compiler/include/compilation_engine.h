@@ -7,14 +7,52 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "compiler_options.h"
+#include "expression.h"
+#include "program_index.h"
 #include "scope_list.h"
-#include "tokenizer.h"
+#include "string_table.h"
+#include "token_buffer.h"
 #include "vm_writer.h"
 
+// What running the statements of a loop may change, as found from their
+// tokens.
+struct LoopEffects {
+  // the variables assigned by `let varName = ...`.
+  std::vector<SymbolData> assigned_vars;
+  // whether an array entry is assigned.
+  bool writes_arrays;
+  // whether a subroutine is called, which may change any field, static or
+  // array.
+  bool calls;
+};
+
+// A local array of constant size that never leaves its subroutine, so its
+// block can be kept in hidden statics and reused by later calls.
+struct StaticArray {
+  // the offset of the local variable holding the array.
+  int local_idx;
+  // the number of entries of the array.
+  int size;
+  // the hidden static holding the block, which is null until first used.
+  int block_static;
+  // the hidden static that is true while a call holds the block.
+  int busy_static;
+};
+
 class CompilationEngine {
 public:
-  CompilationEngine() {}
+  // `program_index` indexes every class of the program in whole-program
+  // mode, and is null otherwise. It is owned by the caller.
+  CompilationEngine(
+    CompilerOptions options, const ProgramIndex* program_index)
+    : token_idx_(0), curr_class_id_(-1), scope_list_(&string_table_),
+      is_reachable_(true), n_hoisted_locals_(0), max_hoisted_locals_(0),
+      returns_no_value_(false), n_hidden_statics_(0),
+      string_pool_ready_static_(-1),
+      options_(options), program_index_(program_index) {}
   CompilationEngine(const CompilationEngine&) = delete;
   CompilationEngine &operator=(const CompilationEngine&) = delete;
   CompilationEngine(CompilationEngine&&) = delete;
@@ -47,6 +85,20 @@ private:
   // compiles an if statement.
   void compileIf();
 
+  // Finds whether the if statement whose condition `condition` has just been
+  // parsed starts a chain `if (key = value) { ... } else { if (key = value)
+  // ...` whose values are few and close enough for a jump table, leaving
+  // the value of each case in `case_values`. Each `else` of the chain must
+  // hold nothing but the next if statement.
+  bool findCaseChain(
+    const Expression* condition, std::vector<int>* case_values);
+
+  // Compiles the rest of a chain found by `findCaseChain` as a jump through
+  // a table indexed by `key` less the lowest value, rather than comparing
+  // `key` with each value in turn.
+  void compileCaseChain(
+    Expression* key, const std::vector<int>& case_values);
+
   // compiles a while statement.
   void compileWhile();
 
@@ -56,24 +108,29 @@ private:
   // compiles a return statement.
   void compileReturn();
 
-  // compiles a term.
-  void compileTerm();
+  // parses a term into an expression tree.
+  Expression* parseTerm();
+
+  // parses an expression into an expression tree.
+  Expression* parseExpression();
 
-  // compiles an expression
+  // compiles an expression, folding its constants before writing it.
   void compileExpression();
 
-  // compiles an expression list and returns the number of expressions in the
-  // list.
-  int compileExpressionList();
+  // parses an expression list, adding each expression as an argument of
+  // `call`.
+  void parseExpressionList(Expression* call);
 
   // Compiles a subroutine declaration.
   void compileSubroutineDec();
 
   // Compiles the body of the subroutine `subroutine_name`. `dec_keyword`
   // identifies the type of subroutine being compiled (function, method, or
-  // constructor).
+  // constructor). If `uses_string_pool` is true, the body starts by making
+  // sure the string pool of the class is built.
   void compileSubroutineBody(
-    std::string subroutine_name, Keyword::Type dec_keyword);
+    std::string subroutine_name, Keyword::Type dec_keyword,
+    bool uses_string_pool);
 
   // Compiles the initialization code for a subroutine of type `dec_keyword`. If
   // it is a constructor, the initialization code allocates enough space for the
@@ -84,41 +141,149 @@ private:
   // Sets the jack file currently being compiled.
   void setJackFile(std::string jack_file);
 
-  // compiles a subroutine call and the name of the subroutine is streamed into
-  // `function_name`.
-  int compileSubroutineCall(std::stringstream* function_name);
+  // parses a subroutine call into a CALL expression. Method calls take the
+  // object they are called on as their first argument. In whole-program
+  // mode, a call of a getter is parsed into the field it reads.
+  Expression* parseSubroutineCall();
+
+  // Returns whether `function_name` is called with `call-void` and returns
+  // with `return-void`, pushing and popping no return value. That is every
+  // void subroutine of the program in whole-program mode with the VM
+  // extensions, other than `Main.main`, which the OS calls expecting a value.
+  bool returnsNoValue(const std::string& function_name);
+
+  // Returns the field read by `call` if it calls a getter that can be
+  // inlined, and `call` itself otherwise.
+  Expression* inlineGetterCall(Expression* call);
+
+  // Writes the VM code assigning the field written by `call` if it calls a
+  // setter that can be inlined. Returns false, writing nothing, otherwise.
+  bool writeInlineSetterCall(const Expression* call);
 
   // Compiles additional variables listed in a variable declaration statement.
   // `var_type` and `var_segment` represent the variable segment and type,
   // respectively, of the variables being compiled. `compile_tag` is a string
   // representing the name of the statement being compiled.
   void compileAdditionalVarDecs(
-    std::string var_type, Segment var_segment, const std::string compile_tag);
+    int var_type, Segment var_segment, const std::string compile_tag);
+
+  // Parses the condition of an if or while statement and folds its
+  // constants. The condition has the form `(expression)` as in
+  // `if (expression) { ... }`.
+  Expression* parseStatementCondition(const std::string compile_tag);
 
-  // Compiles the condition of an if or while statement. The condition has the
-  // form `(expression)` as in `if (expression) { ... }`.
-  void compileStatementCondition(const std::string compile_tag);
+  // Sets whether the code being compiled can run. Code that cannot run is
+  // still checked for errors, but is not written.
+  void setReachable(bool is_reachable);
 
   // Compiles a scoped set of statements. That is, a set of statements between
   // `{` and `}`.
   void compileScopedStatements(const std::string compile_tag);
 
-  // Compiles a keyword constant to VM code.
-  void compileKeywordConstant();
-
-  // Compiles the right side of an equation as part of a let statement. That
-  // is, it handles the `=` and the right side expression.
-  void compileRightSideOfEquation(std::string compile_tag);
-
-  // Compiles a string constant.
-  void compileStringConstant();
-
-  // Compiles a simple term: an integer, a string, or a keyword constant.
-  void compileSimpleTerm();
-
-  // Gets the associated `SymbolData` for `var_name` from the scope list. An
-  // error is generated if the variable is not in the scope list.
-  SymbolData getVarData(std::string var_name);
+  // Parses a keyword constant. `this` is the variable `pointer 0`, and the
+  // other keyword constants are integer constants.
+  Expression* parseKeywordConstant();
+
+  // Parses the right side of an equation as part of a let statement. That
+  // is, it handles the `=` and parses the right side expression, folding its
+  // constants.
+  Expression* parseRightSideOfEquation(std::string compile_tag);
+
+  // Writes the VM code creating the string constant `string_id`.
+  void writeStringConstant(int string_id);
+
+  // Returns the hidden static holding the string `string_id` in the string
+  // pool of the class, adding the string to the pool if it is new.
+  int getStringPoolSlot(int string_id);
+
+  // Returns a new hidden static of the current class. Hidden statics follow
+  // the statics of the class, which are all declared before the first
+  // subroutine.
+  int allocateHiddenStatic();
+
+  // Writes the VM code calling the string pool init function of the class if
+  // the pool has not been built yet.
+  void writeStringPoolCheck();
+
+  // Writes the function building every string in the string pool of the
+  // class into its hidden static.
+  void writeStringPoolInit();
+
+  // Returns whether the subroutine starting at the current token contains a
+  // string constant.
+  bool subroutineHasStringConstant();
+
+  // Writes the VM code pushing the 16 bit constant `value`.
+  void writeIntConstant(int value);
+
+  // Writes the VM code evaluating `expression` onto the stack.
+  void writeExpression(const Expression* expression);
+
+  // Finds the address THAT must hold to reach the array entry `element` as
+  // `that that_idx`. That is the array itself for a constant index, or the
+  // array plus the index for an index held in a variable. Returns false if
+  // the entry is not reached through THAT.
+  bool getThatAddress(
+    const Expression* element, ThatAddress* address, int* that_idx);
+
+  // Writes the VM code pointing THAT at `address`, unless it already does.
+  void writeThatAddress(const ThatAddress& address);
+
+  // Writes the VM code storing `value` into the array entry `element`.
+  void writeArrayStore(const Expression* element, const Expression* value);
+
+  // Finds what the loop statements starting at the current token `{` may
+  // change, without compiling them.
+  LoopEffects scanLoopStatements();
+
+  // Determines if evaluating `expression` gives the same value on every
+  // iteration of a loop with `effects`.
+  bool isLoopInvariant(
+    const Expression* expression, const LoopEffects& effects);
+
+  // Writes the VM code computing each part of the loop condition `*slot`
+  // that is worth keeping and does not change in a loop with `effects`
+  // into a new local variable, replacing the part with the variable.
+  void hoistLoopInvariants(Expression** slot, const LoopEffects& effects);
+
+  // Finds the local arrays of the subroutine body starting at the current
+  // token that can be kept in hidden statics. Such an array is created by a
+  // single `let v = Array.new(size);` with a small constant size, and is
+  // otherwise only indexed or disposed of.
+  void findStaticArrays();
+
+  // Returns the static array held by the variable `var_data`, or nullptr if
+  // it does not hold one.
+  const StaticArray* getStaticArray(const SymbolData& var_data);
+
+  // Writes the VM code pointing the local of `array` at its block, taking
+  // the block unless another call holds it. A call that finds the block held
+  // by another allocates a new array, as the subroutine has been reentered.
+  void writeStaticArrayAllocation(const StaticArray& array);
+
+  // Writes the VM code giving up the block of `array` if its local holds it,
+  // and jumping to `not_held_label` otherwise.
+  void writeStaticArrayRelease(
+    const StaticArray& array, const std::string& not_held_label);
+
+  // Writes the VM code jumping to `label` if `condition` evaluates to
+  // `jump_if_true`, and carrying on otherwise. Comparisons, and `~`, `&` and
+  // `|` of comparisons, are written as jumps on their outcome, without
+  // computing the boolean and negating it.
+  void writeConditionalJump(
+    const Expression* condition, bool jump_if_true, const std::string& label);
+
+  // Writes the VM code evaluating `operand * factor` onto the stack with
+  // additions, rather than a call to Math.multiply.
+  void writeMultiplyByConstant(const Expression* operand, int factor);
+
+  // Parses a simple term: an integer, a string, or a keyword constant.
+  Expression* parseSimpleTerm();
+
+  // Gets the associated `SymbolData` for the variable with interned name
+  // `var_id` from the scope list. An error is generated if the variable is not
+  // in the scope list.
+  const SymbolData& getVarData(int var_id);
 
   // Handles the expectation that the compiler expects to receive keyword `k`.
   // If `k` is not the next token, an exception is thrown.
@@ -144,16 +309,17 @@ private:
   // Retrieves a variable name from the current token and adds the variable
   // definition to the symbol table under segment `var_segment` and with type
   // `var_type`.
-  void handleVariableDefinition(std::string var_type, Segment var_segment);
+  void handleVariableDefinition(int var_type, Segment var_segment);
 
-  // Retrieves a type from the current token and advances the tokenizer. If the
-  // current token does not represent a valid type, an error is raised.
-  std::string getType();
+  // Retrieves the interned id of a type from the current token and advances
+  // the tokenizer. If the current token does not represent a valid type, an
+  // error is raised.
+  int getType();
 
-  // Retrieves a variable name for the current token and advances the tokenizer.
-  // If the current token does not represent a valid identifier, an error is
-  // raised.
-  std::string getVarName();
+  // Retrieves the interned id of a variable name for the current token and
+  // advances the tokenizer. If the current token does not represent a valid
+  // identifier, an error is raised.
+  int getVarName();
 
   // Handles the end of a statement. That is, expects and outputs the token `;`.
   // If the token is not found, an error is generated.
@@ -169,18 +335,14 @@ private:
   void handleClosingParenthesis(
     char parenthesis, const std::string compile_tag);
 
-  // Streams the class associated with `identifier_name` into `function_name`.
-  // If `identifier_name` is the name of a class, the class is streamed into
-  // `function_name`. Otherwise, it is the name of a variable, the type of the
-  // variable identifies the function to which it belongs and the variable is
-  // the first argument to the function.
-  void handleSymbolDataForSubroutine(
-    std::stringstream* function_name, int* n_args, std::string identifier_name);
-
   // Returns whether the current token pointed to by the tokenizer is the
   // symbol `expected_symbol`.
   bool currentTokenIsExpectedSymbol(char expected_symbol);
 
+  // Returns whether the token after the current token is the symbol
+  // `expected_symbol`.
+  bool nextTokenIsExpectedSymbol(char expected_symbol);
+
   // Returns whether the current token pointed to by the tokenizer is the
   // keyword `k`.
   bool currentTokenIsExpectedKeyword(Keyword::Type k);
@@ -209,20 +371,83 @@ private:
   // Constructs an output label from `label`, accounting for the `label_count_`.
   std::string constructOutputLabel(std::string label);
 
-  // The tokenizer used to retrieve tokens from the jack file being compiled.
-  std::unique_ptr<Tokenizer> tokenizer_;
+  // Advances to the next token of the buffer.
+  void nextToken();
+
+  // The type of the current token.
+  TokenType getTokenType() { return tokens_.getType(token_idx_); }
+
+  // The keyword of the current token. Should only be called if the token type
+  // is KEYWORD.
+  Keyword::Type getKeyword() { return tokens_.getKeyword(token_idx_); }
+
+  // The symbol of the current token. Should only be called if the token type
+  // is SYMBOL.
+  char getSymbol() { return tokens_.getSymbol(token_idx_); }
+
+  // The interned spelling of the current token. Should only be called if the
+  // token type is IDENTIFIER, KEYWORD, or STRING_CONST.
+  int getTokenId() { return tokens_.getId(token_idx_); }
+
+  // Gets the current token as a string, for error messages and names.
+  std::string tokenToString();
+
+  // The identifiers and string constants of the jack file being compiled.
+  StringTable string_table_;
+
+  // The tokens of the jack file being compiled and the index of the current
+  // token.
+  TokenBuffer tokens_;
+  size_t token_idx_;
 
   // The VM Writer used to write compiled VM code to the appropriate VM file.
   std::unique_ptr<VMWriter> vm_writer_;
 
-  // The name of the current class being compiled.
+  // The name of the current class being compiled, and its interned id.
   std::string curr_class_;
+  int curr_class_id_;
 
   // Handles the scope hierarchy throughout compilation of a class.
-  std::unique_ptr<ScopeList> scope_list_;
+  ScopeList scope_list_;
+
+  // Whether the code being compiled can run.
+  bool is_reachable_;
+
+  // The number of local variables added to the subroutine being compiled
+  // that hold values hoisted out of the loops being compiled, and the most
+  // that have been needed at once.
+  int n_hoisted_locals_;
+  int max_hoisted_locals_;
+
+  // Whether the subroutine being compiled returns with `return-void`.
+  bool returns_no_value_;
+
+  // The number of hidden statics of the current class.
+  int n_hidden_statics_;
+
+  // The static arrays of the subroutine being compiled.
+  std::vector<StaticArray> static_arrays_;
+
+  // The expression trees of the subroutine being compiled.
+  ExpressionArena expression_arena_;
+
+  // The interned ids of the strings in the string pool of the current class,
+  // and the hidden statics holding them.
+  std::vector<int> pooled_strings_;
+  std::vector<int> pooled_string_statics_;
+
+  // The hidden static holding the first string of the string pool, which is
+  // null until the pool is built, or -1 if it has not been allocated.
+  int string_pool_ready_static_;
 
   // The count of the number of labels used in the current compilation.
   int label_count_;
+
+  // The options controlling the generated VM code.
+  CompilerOptions options_;
+
+  // The classes of the whole program, or null outside of whole-program mode.
+  const ProgramIndex* program_index_;
 };
 
 #endif  // COMPILATION_ENGINE_H
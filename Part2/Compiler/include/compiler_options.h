@@ -0,0 +1,28 @@
+// The options controlling the VM code generated by the compiler.
+#ifndef COMPILER_OPTIONS_H
+#define COMPILER_OPTIONS_H
+
+struct CompilerOptions {
+  // Emit the extended VM operations `inc`, `dec`, `load`, `store`, `dup`,
+  // `drop`, `ge`, `le` and `ne`. The output then needs a VM translator that
+  // understands them.
+  bool vm_extensions = false;
+  // Build each distinct string constant of a class once, into a hidden
+  // static, rather than every time it is evaluated. The strings are then
+  // shared, so a program must not change or dispose of a string constant.
+  bool string_pool = false;
+  // Give each small local array of constant size that never leaves its
+  // subroutine a block that is allocated once and reused by later calls,
+  // rather than allocated and disposed of on every call. The entries of a
+  // reused block start with the values left by its last use.
+  bool static_arrays = false;
+  // Index every class of the program before compiling any, check the number
+  // of arguments of every call of a subroutine of the program, and inline the
+  // calls of methods that only read or only assign one field. With the VM
+  // extensions, void subroutines are also called with `call-void` and return
+  // with `return-void`. The compiled classes then depend on the classes they
+  // call, so they must be compiled together again whenever those change.
+  bool whole_program = false;
+};
+
+#endif  // COMPILER_OPTIONS_H
@@ -105,6 +105,12 @@ public:
   explicit InvalidFunctionReturnType(std::string received_token);
 };
 
+class WrongArgumentCount : public std::runtime_error {
+public:
+  WrongArgumentCount(
+    std::string function_name, int expected_count, int received_count);
+};
+
 class KeywordNotFound : public std::runtime_error {
 public:
   KeywordNotFound(Keyword::Type expected_keyword, std::string received_token);
@@ -0,0 +1,76 @@
+// The expression tree built for each Jack expression before any VM code is
+// written for it. Seeing a whole expression at once lets the compiler fold
+// constants and simplify the arithmetic before generating code.
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "segment.h"
+
+enum class ExpressionType {
+  INT_CONST = 0,
+  STRING_CONST = 1,
+  VARIABLE = 2,
+  ARRAY_ELEMENT = 3,
+  CALL = 4,
+  UNARY_OP = 5,
+  BINARY_OP = 6
+};
+
+struct Expression {
+  ExpressionType type;
+  // the 16 bit value of an INT_CONST, the interned id of a STRING_CONST, or
+  // the operator symbol of a UNARY_OP or BINARY_OP.
+  int value;
+  // the variable of a VARIABLE, or the array of an ARRAY_ELEMENT.
+  Segment segment;
+  int offset;
+  // the function called by a CALL.
+  std::string function_name;
+  // the operands of an operator, the index of an ARRAY_ELEMENT, or the
+  // arguments of a CALL, in the order they are evaluated.
+  std::vector<Expression*> operands;
+};
+
+// Owns the expressions of a subroutine. The expressions are freed all at
+// once, and their storage is reused by the expressions of the next
+// subroutine.
+class ExpressionArena {
+public:
+  ExpressionArena() : n_used_(0) {}
+  ExpressionArena(const ExpressionArena&) = delete;
+  ExpressionArena &operator=(const ExpressionArena&) = delete;
+  ExpressionArena(ExpressionArena&&) = delete;
+  ExpressionArena &operator=(ExpressionArena&&) = delete;
+  ~ExpressionArena() {}
+
+  // returns a new expression of type `type` without any operands.
+  Expression* create(ExpressionType type);
+
+  // frees every expression created since the last clear.
+  void clear() { n_used_ = 0; }
+
+private:
+  // a deque never moves its elements, so expressions stay where they are.
+  std::deque<Expression> expressions_;
+  size_t n_used_;
+};
+
+// Determines if evaluating `expression` may do more than compute a value,
+// that is if it calls a subroutine or creates a string.
+bool HasSideEffects(const Expression* expression);
+
+// Determines if `expression` always evaluates to a boolean, true (-1) or
+// false (0), such as a comparison or the `&` of two comparisons.
+bool IsBooleanExpression(const Expression* expression);
+
+// Folds the constant parts of `expression` and simplifies arithmetic on
+// constants, such as `x + 0` or `x * 1`, following the 16 bit arithmetic of
+// the Hack platform. Returns the simplified expression, which may be one of
+// the operands of `expression`. The expression is changed in place.
+Expression* FoldExpression(Expression* expression);
+
+#endif  // EXPRESSION_H
@@ -2,8 +2,8 @@
 #ifndef KEYWORD_H
 #define KEYWORD_H
 
-#include <unordered_map>
 #include <string>
+#include <string_view>
 
 class Keyword {
 public:
@@ -35,15 +35,15 @@ public:
 
   static std::string KeywordToString(Keyword::Type k);
 
-  static Keyword::Type GetKeywordFromString(const std::string keyword_str);
+  // the keyword spelled by `keyword_str`, or UNKNOWN if it is not a keyword.
+  // Found with a perfect hash, so this is one table lookup and comparison.
+  static Keyword::Type GetKeywordFromString(std::string_view keyword_str);
 
-  static bool IsKeyword(const std::string token_str);
+  static bool IsKeyword(std::string_view token_str);
 
   static bool IsPrimitiveType(const Keyword::Type k);
 
   static bool IsKeywordConstant(const Keyword::Type k);
-private:
-  static std::unordered_map<std::string, Keyword::Type> const keyword_map_;
 };
 
 #endif  // KEYWORD_H
@@ -0,0 +1,69 @@
+// Indexes the subroutines of every class of a program before any class is
+// compiled, so that the compilation of one class can make use of what the
+// others declare, such as the arity and return type of each subroutine. The
+// index is built once and then only read, so it can be shared by the
+// compilation engines of every thread.
+#ifndef PROGRAM_INDEX_H
+#define PROGRAM_INDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "keyword.h"
+#include "string_table.h"
+#include "token_buffer.h"
+
+// How a call of a subroutine can be replaced by its body.
+enum class InlineKind {
+  // the subroutine must be called.
+  NONE = 0,
+  // a method whose body is `return fieldName;`.
+  GETTER = 1,
+  // a method with one parameter whose body is
+  // `let fieldName = parameter; return;`.
+  SETTER = 2
+};
+
+struct SubroutineInfo {
+  // one of `constructor`, `function` or `method`.
+  Keyword::Type kind;
+  // whether the return type is `void`.
+  bool returns_void;
+  // the number of declared parameters, not counting the object of a method.
+  int n_parameters;
+  InlineKind inline_kind;
+  // the offset, in the `this` segment, of the field read by a getter or
+  // written by a setter.
+  int field_idx;
+};
+
+class ProgramIndex {
+public:
+  ProgramIndex() {}
+  ProgramIndex(const ProgramIndex&) = delete;
+  ProgramIndex &operator=(const ProgramIndex&) = delete;
+  ProgramIndex(ProgramIndex&&) = delete;
+  ProgramIndex &operator=(ProgramIndex&&) = delete;
+  ~ProgramIndex() {}
+
+  // Adds the subroutines of every class of `jack_file`. Indexing stops at
+  // the first class that is not well formed, as the error is reported when
+  // the file is compiled.
+  void addFile(const std::string& jack_file);
+
+  // The subroutine named `function_name`, of the form `Class.subroutine`, or
+  // nullptr if no indexed class declares it.
+  const SubroutineInfo* findSubroutine(const std::string& function_name) const;
+
+private:
+  // Adds the subroutines of the class starting at token `*idx` of `tokens`,
+  // leaving `*idx` after the class. Returns false if the class is not well
+  // formed.
+  bool addClass(
+    const TokenBuffer& tokens, const StringTable& string_table, size_t* idx);
+
+  std::unordered_map<std::string, SubroutineInfo> subroutines_;
+};
+
+#endif  // PROGRAM_INDEX_H
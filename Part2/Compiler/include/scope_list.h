@@ -3,38 +3,47 @@
 // represents the narrowest scope, with each successive node representing a
 // wider scope.
 // However, the Jack language only has 2 scopes: class level and subroutine
-// level. So we use only 2 attributes for the 2 scopes, with the subroutine
-// scope possibly being null, when compiling at the class level. Note the
-// class level is never null because all code must be compiled inside a class.
+// level. So we use only 2 tables for the 2 scopes, with the subroutine scope
+// only in use while compiling a subroutine. Both tables are reused from one
+// class or subroutine to the next, rather than allocated for each.
 #ifndef SCOPE_LIST_H
 #define SCOPE_LIST_H
 
-#include <memory>
-#include <string>
-
 #include "segment.h"
+#include "string_table.h"
 #include "symbol_table.h"
 
 class ScopeList {
 public:
-  ScopeList();
+  // `string_table` holds the names of the symbols, for error messages. It is
+  // owned by the caller.
+  ScopeList(const StringTable* string_table);
   ScopeList(const ScopeList&) = delete;
   ScopeList &operator=(const ScopeList&) = delete;
   ScopeList(ScopeList&&) = delete;
   ScopeList &operator=(ScopeList&&) = delete;
   ~ScopeList() {}
 
+  // empties both scopes, ready to compile a new class.
+  void startClass();
+
+  // empties the subroutine scope, ready to compile a new subroutine.
   void startSubroutine();
 
-  void define(std::string var_name, std::string var_type, Segment var_segment);
+  void define(int var_id, int type_id, Segment var_segment);
 
   int varCount(Segment segment);
 
-  SymbolData getVarData(std::string var_name);
+  // the symbol named `var_id` in the narrowest scope declaring it. The symbol
+  // has segment UNKNOWN if no scope declares it. The reference is valid until
+  // the next symbol is defined.
+  const SymbolData& getVarData(int var_id);
 
 private:
-  std::unique_ptr<ClassTable> class_scope_;
-  std::unique_ptr<SubroutineTable> subroutine_scope_;
+  const StringTable* string_table_;
+  SymbolTable class_scope_;
+  SymbolTable subroutine_scope_;
+  bool in_subroutine_;
 };
 
 #endif  // SCOPE_LIST_H
@@ -0,0 +1,36 @@
+// Interns the identifiers and string constants of a compilation, giving each
+// distinct string a small integer id. Compiling with ids means names are
+// compared as integers and copied without allocating.
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class StringTable {
+public:
+  StringTable() {}
+  StringTable(const StringTable&) = delete;
+  StringTable &operator=(const StringTable&) = delete;
+  StringTable(StringTable&&) = delete;
+  StringTable &operator=(StringTable&&) = delete;
+  ~StringTable() {}
+
+  // Returns the id of `str`, adding it to the table if it is new.
+  int intern(std::string_view str);
+
+  // Returns the string with id `id`.
+  const std::string& getString(int id) const { return strings_[id]; }
+
+  // Removes every string, so ids start again from 0.
+  void clear();
+
+private:
+  // A deque never moves its elements, so the views in `ids_` stay valid.
+  std::deque<std::string> strings_;
+  std::unordered_map<std::string_view, int> ids_;
+};
+
+#endif  // STRING_TABLE_H
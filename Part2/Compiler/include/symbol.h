@@ -15,7 +15,11 @@ enum class OpCommand {
   AND = 6,
   OR = 7,
   NOT = 8,
-  UNKNOWN = 9
+  // the extended comparisons, which are the negations of `LT`, `GT` and `EQ`.
+  GE = 9,
+  LE = 10,
+  NE = 11,
+  UNKNOWN = 12
 };
 
 static std::unordered_map<char, OpCommand> const unaryOpsMap = {
@@ -33,6 +37,13 @@ static std::unordered_map<char, OpCommand> const simpleBinaryOpsMap = {
   {'=', OpCommand::EQ}
 };
 
+// The extended comparison negating each comparison operator.
+static std::unordered_map<char, OpCommand> const negatedComparisonOpsMap = {
+  {'<', OpCommand::GE},
+  {'>', OpCommand::LE},
+  {'=', OpCommand::NE}
+};
+
 static std::unordered_map<char, std::string> const mathOpsMap = {
   {'*', "Math.multiply"},
   {'/', "Math.divide"}
@@ -76,6 +87,15 @@ static OpCommand GetSimpleBinaryOpCommand(const char curr_char) {
   return simpleBinaryOpsMap.find(curr_char)->second;
 }
 
+static bool IsComparisonOp(const char curr_char) {
+  return (negatedComparisonOpsMap.find(curr_char) !=
+          negatedComparisonOpsMap.end());
+}
+
+static OpCommand GetNegatedComparisonCommand(const char curr_char) {
+  return negatedComparisonOpsMap.find(curr_char)->second;
+}
+
 static std::string GetMathOpFunction(const char curr_char) {
   return mathOpsMap.find(curr_char)->second;
 }
@@ -108,6 +128,12 @@ static std::string OpCommandToString(OpCommand op_command) {
       return "or";
     case OpCommand::NOT:
       return "not";
+    case OpCommand::GE:
+      return "ge";
+    case OpCommand::LE:
+      return "le";
+    case OpCommand::NE:
+      return "ne";
     default:
       return "unknown";
   }
@@ -2,65 +2,49 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
-#include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "segment.h"
 
+// The names and types of symbols are ids interned in the compilation's
+// string table.
 struct SymbolData {
-  std::string symbol_type;
+  int name_id;
+  int type_id;
   Segment segment;
   int offset;
 };
 
+// The symbols of a scope are kept in a flat array and found by a linear scan,
+// which beats hashing for the handful of variables a Jack scope declares.
+// Clearing the table keeps its storage, so a table reused for successive
+// scopes stops allocating once it has seen its largest scope.
 class SymbolTable {
 public:
-  SymbolTable() {}
+  SymbolTable();
   SymbolTable(const SymbolTable&) = delete;
   SymbolTable &operator=(const SymbolTable&) = delete;
   SymbolTable(SymbolTable&&) = delete;
   SymbolTable &operator=(SymbolTable&&) = delete;
   ~SymbolTable() {}
 
-  int getSegmentCount(Segment segment);
+  // removes every symbol, keeping the storage for the next scope.
+  void clear();
 
-  SymbolData getSymbolData(std::string var_name);
-protected:
-  void addSymbol(
-    std::string symbol_name, std::string symbol_type, Segment symbol_segment);
+  int getSegmentCount(Segment segment) const {
+    return segment_counts_[static_cast<int>(segment)];
+  }
 
-  std::unordered_map<std::string, SymbolData> symbol_map_;
-  std::unordered_map<Segment, int> segment_counts_;
-};
-
-// Specialization of a symbol table to handle class variables.
-class ClassTable : public SymbolTable {
-public:
-  ClassTable();
-  ClassTable(const ClassTable&) = delete;
-  ClassTable &operator=(const ClassTable&) = delete;
-  ClassTable(ClassTable&&) = delete;
-  ClassTable &operator=(ClassTable&&) = delete;
-  virtual ~ClassTable() {}
-
-  void addFieldVar(std::string var_name, std::string var_type);
-
-  void addStaticVar(std::string var_name, std::string var_type);
-};
-
-// Specialization of a symbol table to handle subroutine variables.
-class SubroutineTable : public SymbolTable {
-public:
-  SubroutineTable();
-  SubroutineTable(const SubroutineTable&) = delete;
-  SubroutineTable &operator=(const SubroutineTable&) = delete;
-  SubroutineTable(SubroutineTable&&) = delete;
-  SubroutineTable &operator=(SubroutineTable&&) = delete;
-  ~SubroutineTable() {}
+  // returns the symbol named `name_id`, or null if it is not in the table.
+  const SymbolData* findSymbol(int name_id) const;
 
-  void addArgumentVar(std::string var_name, std::string var_type);
+  // adds the symbol named `name_id` at the next offset of `segment`. Returns
+  // false, without adding it, if the symbol is already in the table.
+  bool addSymbol(int name_id, int type_id, Segment segment);
 
-  void addLocalVar(std::string var_name, std::string var_type);
+private:
+  std::vector<SymbolData> symbols_;
+  int segment_counts_[static_cast<int>(Segment::UNKNOWN) + 1];
 };
 
 #endif  // SYMBOL_TABLE_H
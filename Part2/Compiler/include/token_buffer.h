@@ -0,0 +1,75 @@
+// The tokens of a whole Jack file, lexed once up front and stored as a
+// struct of arrays indexed by token position. The compilation engine walks
+// the buffer with an index, so looking ahead costs nothing.
+#ifndef TOKEN_BUFFER_H
+#define TOKEN_BUFFER_H
+
+#include <string>
+#include <vector>
+
+#include "keyword.h"
+#include "string_table.h"
+#include "token_type.h"
+#include "tokenizer.h"
+
+class TokenBuffer {
+public:
+  TokenBuffer() {}
+  TokenBuffer(const TokenBuffer&) = delete;
+  TokenBuffer &operator=(const TokenBuffer&) = delete;
+  TokenBuffer(TokenBuffer&&) = delete;
+  TokenBuffer &operator=(TokenBuffer&&) = delete;
+  ~TokenBuffer() {}
+
+  // Replaces the buffer with every token of `tokenizer`, interning the
+  // spelling of identifiers, keywords and string constants in
+  // `string_table`. The buffer always ends with an UNKNOWN token.
+  void lex(Tokenizer* tokenizer, StringTable* string_table);
+
+  // The number of tokens, including the final UNKNOWN token.
+  size_t size() const { return types_.size(); }
+
+  TokenType getType(size_t idx) const { return types_[idx]; }
+
+  // The interned spelling of the token at `idx`. Only valid for identifiers,
+  // keywords and string constants.
+  int getId(size_t idx) const { return ids_[idx]; }
+
+  // The value of an integer constant.
+  int getIntVal(size_t idx) const { return values_[idx]; }
+
+  // The keyword of a keyword token.
+  Keyword::Type getKeyword(size_t idx) const {
+    return static_cast<Keyword::Type>(values_[idx]);
+  }
+
+  // The character of a symbol token.
+  char getSymbol(size_t idx) const { return static_cast<char>(values_[idx]); }
+
+  // The position in the file of the first character of the token at `idx`.
+  size_t getOffset(size_t idx) const { return offsets_[idx]; }
+
+  // Whether the token at `idx` is the symbol `symbol`. False if `idx` is
+  // past the end of the buffer.
+  bool isSymbol(size_t idx, char symbol) const {
+    return (idx < types_.size()) && (types_[idx] == TokenType::SYMBOL) &&
+      (getSymbol(idx) == symbol);
+  }
+
+  // Whether the token at `idx` is the keyword `k`. False if `idx` is past
+  // the end of the buffer.
+  bool isKeyword(size_t idx, Keyword::Type k) const {
+    return (idx < types_.size()) && (types_[idx] == TokenType::KEYWORD) &&
+      (getKeyword(idx) == k);
+  }
+
+private:
+  std::vector<TokenType> types_;
+  // interned spellings, or -1 for symbols and integer constants.
+  std::vector<int> ids_;
+  // the integer value, keyword or symbol character, depending on the type.
+  std::vector<int> values_;
+  std::vector<size_t> offsets_;
+};
+
+#endif  // TOKEN_BUFFER_H
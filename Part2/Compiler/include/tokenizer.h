@@ -1,11 +1,12 @@
 // Used to serialize an input stream into a sequence of Jack-language tokens.
 // These tokens are then used by the syntax analyzer to translate to VM code.
+// The file is mapped into memory and scanned in place, so tokens are slices
+// of the file and advancing allocates nothing.
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <string_view>
 
 #include "keyword.h"
 #include "token_type.h"
@@ -17,7 +18,7 @@ public:
   Tokenizer &operator=(const Tokenizer&) = delete;
   Tokenizer(Tokenizer&&) = delete;
   Tokenizer &operator=(Tokenizer&&) = delete;
-  ~Tokenizer() {}
+  ~Tokenizer();
 
   // Determines if the stream has any more tokens.
   bool hasMoreTokens();
@@ -36,41 +37,57 @@ public:
   // Gets the current token as a string.
   std::string tokenToString();
 
+  // The text of the current token, valid until the tokenizer is destroyed.
+  // A string constant does not include its quotes.
+  std::string_view getTokenView() { return token_; }
+
+  // The position in the file of the first character of the current token, or
+  // the size of the file once there are no more tokens.
+  size_t getTokenOffset() { return token_offset_; }
+
   // Returns the keyword corresponding to the current token.
   // Should only be called if the token type is KEYWORD.
-  const Keyword::Type getKeyword();
+  const Keyword::Type getKeyword() { return keyword_; }
 
   // Returns the symbol corresponding to the current token.
   // Should only be called if the token type is SYMBOL.
-  const char getSymbol();
+  const char getSymbol() { return token_[0]; }
 
   // Returns the identifier corresponding to the current token.
   // Should only be called if the token type is IDENTIFIER.
-  const std::string getIdentifier();
+  const std::string getIdentifier() { return std::string(token_); }
 
   // Returns the integer corresponding to the current token.
   // Should only be called if the token type is INT_CONST.
-  const int getIntVal();
+  const int getIntVal() { return int_val_; }
 
   // Returns the string corresponding to the current token.
   // Should only be called if the token type is STRING_CONST.
-  const std::string getStringVal();
+  const std::string getStringVal() { return std::string(token_); }
 private:
-  // Removes the current comment pointed to by the jack_stream_.
-  void removeComment(char next_char);
+  // Skips the comment starting at the current position.
+  void removeComment();
 
-  // retrieves the next character from the jack stream.
-  char getNextCharFromJackStream();
+  // Identifies whether a comment starts at the current position.
+  bool startsComment();
 
-  // Identifies whether `next_char` is the first character of a comment.
-  bool startsComment(char next_char);
+  // Throws if the character at the current position cannot follow an integer
+  // or identifier.
+  void expectTokenEnd();
 
-  // The stream for the input file.
-  std::ifstream jack_stream_;
+  // The contents of the Jack file and the position of the next character.
+  // `mapped_data_` is the mapping of the file, if it could be mapped.
+  const char* jack_data_;
+  size_t jack_size_;
+  size_t pos_;
+  void* mapped_data_;
 
-  // The token type and a stream of characters representing the current token.
+  // The current token and its value for keywords and integers.
   TokenType token_type_;
-  std::stringstream token_stream_;
+  std::string_view token_;
+  size_t token_offset_;
+  Keyword::Type keyword_;
+  int int_val_;
 };
 
 #endif  // TOKENIZER_H
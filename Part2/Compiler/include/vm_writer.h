@@ -1,16 +1,39 @@
-// Used to handle writing compiled jack code to a VM file.
+// Used to handle writing compiled jack code to a VM file. The commands of
+// each function are held until the function ends, so that local variables
+// can still be added to it.
+//
+// With the VM extensions enabled, the writer also replaces each sequence
+// `push x`, `push constant 1`, `add` (or `sub`), `pop x` with the single
+// command `inc x` (or `dec x`). Commands that may start such a sequence are
+// held back until it is known whether the sequence is complete.
+//
+// The writer also keeps track of the array address held in THAT, so that
+// array accesses through the same address can reuse it rather than setting
+// THAT again.
 #ifndef VM_WRITER_H
 #define VM_WRITER_H
 
 #include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "segment.h"
 #include "symbol.h"
 
+// An address pointed to with `pop pointer 1`: the value of the variable
+// `base_segment base_idx`, plus the value of the variable
+// `index_segment index_idx` unless `index_segment` is UNKNOWN.
+struct ThatAddress {
+  Segment base_segment;
+  int base_idx;
+  Segment index_segment;
+  int index_idx;
+};
+
 class VMWriter {
 public:
-  VMWriter(std::string jack_file);
+  VMWriter(std::string jack_file, bool vm_extensions);
   VMWriter(const VMWriter&) = delete;
   VMWriter &operator=(const VMWriter&) = delete;
   VMWriter(VMWriter&&) = delete;
@@ -29,15 +52,92 @@ public:
 
   void writeIfGoTo(std::string label);
 
+  // Writes the extended VM command `goto-indexed label n_labels`, which pops
+  // an index `i` and jumps to `label_i` if it is from 0 to n_labels - 1.
+  void writeGoToIndexed(std::string label, int n_labels);
+
   void writeCall(std::string function_name, int n_args);
 
   void writeFunction(std::string function_name, int n_locals);
 
   void writeReturn();
 
+  // Writes the extended VM command `call-void function_name n_args`, calling
+  // a function that returns with `return-void`.
+  void writeCallVoid(std::string function_name, int n_args);
+
+  // Writes the extended VM command `return-void`, returning without a value.
+  void writeReturnVoid();
+
+  // Sets the number of local variables of the function being written, for
+  // local variables added after its `function` command.
+  void setLocalCount(int n_locals);
+
+  // Writes the extended VM command `load`, replacing the address on top of
+  // the stack with the value at that address.
+  void writeLoad();
+
+  // Writes the extended VM command `store`, which pops a value and then an
+  // address and writes the value to the address.
+  void writeStore();
+
+  // Writes the extended VM command `dup`, pushing a copy of the top of the
+  // stack.
+  void writeDup();
+
+  // Writes the extended VM command `drop`, discarding the top of the stack.
+  void writeDrop();
+
+  // Determines if THAT is known to hold `address`.
+  bool thatHolds(const ThatAddress& address);
+
+  // Records that the `pop pointer 1` just written set THAT to `address`.
+  void setThatAddress(const ThatAddress& address);
+
+  // While suppressed, every command is discarded. Used for code that can
+  // never run.
+  void setSuppressed(bool is_suppressed);
+
   void close();
 private:
-  std::ofstream vm_stream_;
+  // Writes the commands held back for a possible `inc` or `dec`.
+  void flushPendingCommands();
+
+  // Writes the function being written, with its `function` command, to the
+  // VM file.
+  void flushFunction();
+
+  // Forgets the address held in THAT if it depends on a variable of
+  // `memory_segment`, or on the variable `memory_segment idx` if `idx` is
+  // not negative.
+  void forgetThatAddressUsing(Segment memory_segment, int idx);
+
+  std::ofstream vm_file_;
+  bool vm_extensions_;
+
+  // The commands of the function being written, which is
+  // `function function_name_ n_locals_` if `has_function_` is true.
+  std::ostringstream vm_stream_;
+  bool has_function_;
+  std::string function_name_;
+  int n_locals_;
+
+  // The commands held back, and the variable and operation of the `inc` or
+  // `dec` they may become.
+  std::vector<std::string> pending_commands_;
+  Segment pending_segment_;
+  int pending_idx_;
+  bool pending_is_increment_;
+
+  bool is_suppressed_;
+
+  // The address held in THAT, if `has_that_address_` is true. It is
+  // forgotten whenever one of its variables may change, and at each label
+  // and function, where control may arrive with THAT holding anything else.
+  // Arrays are taken not to overlap variables, so a write through THAT or
+  // `store` keeps it.
+  bool has_that_address_;
+  ThatAddress that_address_;
 };
 
 #endif  // VM_WRITER_H
@@ -1,5 +1,7 @@
 #include "compilation_engine.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -8,28 +10,82 @@
 #include "segment.h"
 #include "util.h"
 
+// The temps used while multiplying by a constant. The operand, if it is not a
+// variable, is kept in one, and the other is scratch for doubling the
+// product without the VM extensions. Neither is live outside of the
+// multiplication.
+static const int multiply_operand_temp = 1;
+static const int multiply_scratch_temp = 0;
+
+// The name, within its class, of the function building the string pool of
+// the class. Jack identifiers cannot contain `$`, so it never clashes with a
+// subroutine of the class.
+static const std::string string_pool_init_name = "$initStringPool";
+
+// The subroutine the OS calls to run a program.
+static const std::string entry_point_name = "Main.main";
+
+// The most entries of a local array whose block is kept for reuse, as the
+// block stays allocated for the rest of the program.
+static const int max_static_array_size = 32;
+
+// The fewest cases of an if chain written as a jump table, below which
+// comparing with each value is as quick.
+static const int min_jump_table_cases = 3;
+
+// The most entries of a jump table for each case of its if chain. Entries
+// without a case jump to the final else.
+static const int max_jump_table_entries_per_case = 2;
+
+// Returns the index of the token after the block whose `{` is at `idx` of
+// `tokens`, or the size of `tokens` if the block is never closed.
+static size_t skipBlock(const TokenBuffer& tokens, size_t idx) {
+  int depth = 0;
+  for (size_t i = idx; i < tokens.size(); i++) {
+    if (tokens.isSymbol(i, '{')) {
+      depth++;
+    } else if (tokens.isSymbol(i, '}') && (--depth == 0)) {
+      return i + 1;
+    }
+  }
+  return tokens.size();
+}
+
+// Determines if the token at `idx` of `tokens` is the identifier `name`.
+static bool isIdentifierToken(const TokenBuffer& tokens,
+                              const StringTable& string_table,
+                              size_t idx,
+                              const std::string& name) {
+  return (idx < tokens.size()) &&
+    (tokens.getType(idx) == TokenType::IDENTIFIER) &&
+    (string_table.getString(tokens.getId(idx)).compare(name) == 0);
+}
+
 void CompilationEngine::compile(std::string jack_file) {
   setJackFile(jack_file);
-  bool moreClasses = tokenizer_->nextToken();
-  while (moreClasses) {
+  while (getTokenType() != TokenType::UNKNOWN) {
     compileClass();
-    moreClasses = (tokenizer_->getTokenType() != TokenType::UNKNOWN);
   }
   vm_writer_->close();
 }
 
 void CompilationEngine::compileClass() {
-  scope_list_ = std::make_unique<ScopeList>();
+  scope_list_.startClass();
+  n_hidden_statics_ = 0;
+  pooled_strings_.clear();
+  pooled_string_statics_.clear();
+  string_pool_ready_static_ = -1;
 
   const std::string class_tag = "class";
 
   expectKeyword(Keyword::Type::CLASS);
-  tokenizer_->nextToken();
+  nextToken();
 
   // expect an identifier for the class name.
   expectIdentifier();
-  curr_class_ = tokenizer_->tokenToString();
-  tokenizer_->nextToken();
+  curr_class_id_ = getTokenId();
+  curr_class_ = string_table_.getString(curr_class_id_);
+  nextToken();
 
   // opening bracket to start the class definition.
   handleOpeningParenthesis('{', class_tag);
@@ -37,7 +93,7 @@ void CompilationEngine::compileClass() {
   // now we expect a sequence of class var declaration statements.
   while (currentTokenIsClassVarKeyword()) {
     compileClassVarDec();
-    tokenizer_->nextToken();
+    nextToken();
   }
 
   // then we expect a sequence of subroutine declarations. Everything from now
@@ -48,6 +104,10 @@ void CompilationEngine::compileClass() {
 
   // lastly we compile the closing parenthesis
   handleClosingParenthesis('}', class_tag);
+
+  if (!pooled_strings_.empty()) {
+    writeStringPoolInit();
+  }
   return;
 }
 
@@ -57,10 +117,10 @@ void CompilationEngine::compileVarDec() {
 
   // We know `var` is the current token as this is the precondition for
   // entering this method. So just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
 
   // Retrieve the variable type and define the variable.
-  std::string var_type = getType();
+  int var_type = getType();
   handleVariableDefinition(var_type, var_segment);
 
   // Check if we have reached the end of the statement. If not, we have a `,`
@@ -76,11 +136,11 @@ void CompilationEngine::compileClassVarDec() {
 
   // We already know it is a class variable declaration keyword because we check
   // for that before entering this function.
-  Segment var_segment = GetSegmentFromClassVarKeyword(tokenizer_->getKeyword());
-  tokenizer_->nextToken();
+  Segment var_segment = GetSegmentFromClassVarKeyword(getKeyword());
+  nextToken();
 
   // Retrieve the variable type and define the variable.
-  std::string var_type = getType();
+  int var_type = getType();
   handleVariableDefinition(var_type, var_segment);
 
   // Check if we have reached the end of the statement. If not, we have a `,`
@@ -101,7 +161,7 @@ void CompilationEngine::compileParameterList() {
   }
 
   // Get variable type and name as the parameter list is not empty.
-  std::string var_type = getType();
+  int var_type = getType();
   handleVariableDefinition(var_type, var_segment);
 
   // Check for more elements in the parameter list. Either we have hit the end
@@ -110,14 +170,14 @@ void CompilationEngine::compileParameterList() {
     // We have another parameter.
     if (currentTokenIsExpectedSymbol(',')) {
       // Advance past the comma.
-      tokenizer_->nextToken();
+      nextToken();
 
       // Get type and name of next variable in the parameter list.
       var_type = getType();
       handleVariableDefinition(var_type, var_segment);
     } else {
       throw ExpectedClosingParenthesis(
-        tokenizer_->tokenToString(), ")", parameter_list_tag);
+        tokenToString(), ")", parameter_list_tag);
     }
   }
   return;
@@ -128,10 +188,10 @@ void CompilationEngine::compileStatements() {
 
   // Loop through statements, compiling each one.
   while (currentTokenIsStatementKeyword()) {
-    switch (tokenizer_->getKeyword()) {
+    switch (getKeyword()) {
       case Keyword::Type::LET:
         compileLet();
-        tokenizer_->nextToken();
+        nextToken();
         break;
       case Keyword::Type::IF:
         compileIf();
@@ -141,11 +201,11 @@ void CompilationEngine::compileStatements() {
         break;
       case Keyword::Type::DO:
         compileDo();
-        tokenizer_->nextToken();
+        nextToken();
         break;
       default:
         compileReturn();
-        tokenizer_->nextToken();
+        nextToken();
     }
   }
   return;
@@ -156,12 +216,17 @@ void CompilationEngine::compileReturn() {
 
   // We know the first word is return as that is the precondition for entering
   // this method. So we just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
 
   // We haven't hit statement end so we have the form `return expression;`
+  // A subroutine returning no value still evaluates the expression, for its
+  // effects.
   if (!currentTokenIsExpectedSymbol(';')) {
     compileExpression();
-  } else {
+    if (returns_no_value_) {
+      vm_writer_->writeDrop();
+    }
+  } else if (!returns_no_value_) {
     // In this case we just have a simple `return;` statement. But even void
     // methods need to return something so we push 0 onto the stack, expecting
     // the caller will pop it off.
@@ -170,7 +235,22 @@ void CompilationEngine::compileReturn() {
 
   // Now we expect statement end.
   handleStatementEnd(return_tag);
-  vm_writer_->writeReturn();
+
+  // The blocks held by this call are free for the next one.
+  for (const StaticArray& static_array : static_arrays_) {
+    label_count_++;
+    std::string kept_label = constructOutputLabel("ARRAY_NOT_HELD");
+    writeStaticArrayRelease(static_array, kept_label);
+    vm_writer_->writeLabel(kept_label);
+  }
+  if (returns_no_value_) {
+    vm_writer_->writeReturnVoid();
+  } else {
+    vm_writer_->writeReturn();
+  }
+
+  // Nothing after a return in the same block can run.
+  setReachable(false);
   return;
 }
 
@@ -181,42 +261,38 @@ void CompilationEngine::compileLet() {
 
   // We know the first word is `let` as that is the precondition for entering
   // this method. So just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
 
   // expect a valid identifier for the variable name.
   expectIdentifier();
-  SymbolData var_data = getVarData(/*var_name=*/tokenizer_->tokenToString());
-  tokenizer_->nextToken();
+  const SymbolData& var_data = getVarData(/*var_id=*/getTokenId());
+  const StaticArray* static_array = getStaticArray(var_data);
+  nextToken();
 
   // If we encounter `[` then we know we are in the second case.
   if (currentTokenIsExpectedSymbol('[')) {
-    // Push the base address of the array onto the stack, which is the variable.
-    vm_writer_->writePush(var_data.segment, /*idx=*/var_data.offset);
-
-    // Compile the expression for the index and push onto the stack.
+    // The array entry is kept as an expression, so that its address can be
+    // written after the right hand side when that is cheaper.
+    Expression* element =
+      expression_arena_.create(ExpressionType::ARRAY_ELEMENT);
+    element->segment = var_data.segment;
+    element->offset = var_data.offset;
     handleOpeningParenthesis('[', let_tag);
-    compileExpression();
+    element->operands.push_back(FoldExpression(parseExpression()));
     handleClosingParenthesis(']', let_tag);
 
-    // Add the 2 top values on the stack: the array base address and index
-    vm_writer_->writeArithmetic(OpCommand::ADD);
-
-    compileRightSideOfEquation(let_tag);
-
-    // Pop the right hand side off the stack and into temp 0
-    vm_writer_->writePop(Segment::TEMP, 0);
-
-    // Now the top most value on the stack is the address of the array entry
-    // on the left hand side of the equation. So set the THAT segment to this
-    // address, push temp 0 back onto the stack and pop it into THAT 0 which
-    // is the value of the array entry on the left hand side.
-    vm_writer_->writePop(Segment::POINTER, 1);
-    vm_writer_->writePush(Segment::TEMP, 0);
-    vm_writer_->writePop(Segment::THAT, 0);
+    writeArrayStore(element, parseRightSideOfEquation(let_tag));
+  } else if (static_array != nullptr) {
+    // A static array is only assigned by `= Array.new(size)`, as checked by
+    // findStaticArrays, so those 7 tokens are skipped.
+    for (int i = 0; i < 7; i++) {
+      nextToken();
+    }
+    writeStaticArrayAllocation(*static_array);
   } else {
     // We just have a simple assignment to a variable given by `var_name`,
     // so just compile the expression and pop the result into the variable.
-    compileRightSideOfEquation(let_tag);
+    writeExpression(parseRightSideOfEquation(let_tag));
 
     // Then we pop the result of the expression off the stack and into the
     // variable on the left of the `=`.
@@ -232,18 +308,40 @@ void CompilationEngine::compileIf() {
   std::string endif_label = constructOutputLabel("ENDIF");
   std::string endelse_label = constructOutputLabel("ENDELSE");
   const std::string if_tag = "ifStatement";
+  bool was_reachable = is_reachable_;
 
   // We know the first word is `if` as this is the precondition for entering
   // this method. So just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
+
+  Expression* condition = parseStatementCondition(if_tag);
+  if (condition->type == ExpressionType::INT_CONST) {
+    // Only one of the branches can run, so the other is checked but not
+    // written, and no labels are needed. As when the condition is computed,
+    // only true (-1) takes the if, and any other value the else.
+    bool is_taken = (condition->value == -1);
+    setReachable(was_reachable && is_taken);
+    compileScopedStatements(if_tag);
+    bool reaches_end = is_reachable_;
+    setReachable(was_reachable && !is_taken);
+    if (currentTokenIsExpectedKeyword(Keyword::Type::ELSE)) {
+      nextToken();
+      compileScopedStatements(/*compile_tag=*/"elseStatement");
+    }
+    setReachable(reaches_end || is_reachable_);
+    return;
+  }
 
-  compileStatementCondition(if_tag);
+  // A chain of ifs testing one variable against constants jumps straight to
+  // the statements of the matching case.
+  std::vector<int> case_values;
+  if (options_.vm_extensions && findCaseChain(condition, &case_values)) {
+    compileCaseChain(condition->operands[0], case_values);
+    return;
+  }
 
-  // We have compiled the statement condition so it is the top element on the
-  // stack. Now we not it, and if the not is true it means the condition is
-  // false so we go to the end of the if.
-  vm_writer_->writeArithmetic(OpCommand::NOT);
-  vm_writer_->writeIfGoTo(endif_label);
+  // If the condition is false we go to the end of the if.
+  writeConditionalJump(condition, /*jump_if_true=*/false, endif_label);
 
   // Now compile the statements inside the if.
   compileScopedStatements(if_tag);
@@ -253,51 +351,201 @@ void CompilationEngine::compileIf() {
     // end of the else (as part of the if part), so that if we did enter the
     // if, then we skip the else. Then we write the endif label before the else
     // code, signifying that this is where we jump if the if condition is false.
+    // The goto is only written if the end of the if part can be reached.
     vm_writer_->writeGoTo(endelse_label);
+    bool reaches_end = is_reachable_;
+    setReachable(was_reachable);
     vm_writer_->writeLabel(endif_label);
 
-    tokenizer_->nextToken();
+    nextToken();
     compileScopedStatements(/*compile_tag=*/"elseStatement");
 
     // After we compile all the statements of the else, we add the endelse label
     // to signify this is where we jump to if we skip the else statements.
+    setReachable(reaches_end || is_reachable_);
     vm_writer_->writeLabel(endelse_label);
   } else {
     // Otherwise, we just have a simple if statement, so write the endif label
     // as this is the point we jump to if the if condition is false.
+    setReachable(was_reachable);
     vm_writer_->writeLabel(endif_label);
   }
   return;
 }
 
+bool CompilationEngine::findCaseChain(
+  const Expression* condition, std::vector<int>* case_values) {
+  // The condition was the five tokens `(key = value)` before the `{`.
+  size_t i = token_idx_;
+  if ((condition->type != ExpressionType::BINARY_OP) || (i < 5) ||
+      !tokens_.isSymbol(i - 5, '(') ||
+      (tokens_.getType(i - 4) != TokenType::IDENTIFIER) ||
+      !tokens_.isSymbol(i - 3, '=') ||
+      (tokens_.getType(i - 2) != TokenType::INT_CONST) ||
+      !tokens_.isSymbol(i - 1, ')') || !tokens_.isSymbol(i, '{')) {
+    return false;
+  }
+  int key_id = tokens_.getId(i - 4);
+  case_values->assign(1, tokens_.getIntVal(i - 2));
+
+  // Each further case is `else { if (key = value) { ... }`.
+  i = skipBlock(tokens_, i);
+  while (tokens_.isKeyword(i, Keyword::Type::ELSE) &&
+         tokens_.isSymbol(i + 1, '{') &&
+         tokens_.isKeyword(i + 2, Keyword::Type::IF) &&
+         tokens_.isSymbol(i + 3, '(') &&
+         (tokens_.getType(i + 4) == TokenType::IDENTIFIER) &&
+         (tokens_.getId(i + 4) == key_id) &&
+         tokens_.isSymbol(i + 5, '=') &&
+         (tokens_.getType(i + 6) == TokenType::INT_CONST) &&
+         tokens_.isSymbol(i + 7, ')') &&
+         tokens_.isSymbol(i + 8, '{')) {
+    case_values->push_back(tokens_.getIntVal(i + 6));
+    i = skipBlock(tokens_, i + 8);
+  }
+
+  // The last case may have a final else, after which every `else` opened by
+  // the chain must close.
+  if (tokens_.isKeyword(i, Keyword::Type::ELSE) &&
+      tokens_.isSymbol(i + 1, '{')) {
+    i = skipBlock(tokens_, i + 1);
+  }
+  for (size_t n_open = case_values->size() - 1; n_open > 0; n_open--) {
+    if (!tokens_.isSymbol(i, '}')) {
+      return false;
+    }
+    i++;
+  }
+
+  std::vector<int> sorted_values = *case_values;
+  std::sort(sorted_values.begin(), sorted_values.end());
+  int n_cases = sorted_values.size();
+  int n_entries = sorted_values.back() - sorted_values.front() + 1;
+  return (n_cases >= min_jump_table_cases) &&
+    (n_entries <= max_jump_table_entries_per_case * n_cases) &&
+    (std::adjacent_find(sorted_values.begin(), sorted_values.end()) ==
+     sorted_values.end());
+}
+
+void CompilationEngine::compileCaseChain(
+  Expression* key, const std::vector<int>& case_values) {
+  std::string table_label = constructOutputLabel("CASE");
+  std::string default_label = constructOutputLabel("CASE_DEFAULT");
+  std::string end_label = constructOutputLabel("CASE_END");
+  const std::string if_tag = "ifStatement";
+  const std::string else_tag = "elseStatement";
+  bool was_reachable = is_reachable_;
+  int lowest_value =
+    *std::min_element(case_values.begin(), case_values.end());
+  int n_entries =
+    *std::max_element(case_values.begin(), case_values.end()) -
+    lowest_value + 1;
+
+  // The key is compared with every value by the range check of the jump,
+  // which falls through to the final else when no case matches.
+  Expression* lowest = expression_arena_.create(ExpressionType::INT_CONST);
+  lowest->value = lowest_value;
+  Expression* index = expression_arena_.create(ExpressionType::BINARY_OP);
+  index->value = '-';
+  index->operands = {key, lowest};
+  writeExpression(FoldExpression(index));
+  vm_writer_->writeGoToIndexed(table_label, n_entries);
+  vm_writer_->writeGoTo(default_label);
+
+  // We are at the `{` of the first case. Every later case starts with the
+  // `else { if (key = value)` already checked by findCaseChain.
+  std::vector<bool> has_case(n_entries, false);
+  bool reaches_end = false;
+  for (size_t i = 0; i < case_values.size(); i++) {
+    if (i > 0) {
+      nextToken();
+      handleOpeningParenthesis('{', else_tag);
+      nextToken();
+      parseStatementCondition(if_tag);
+    }
+    int entry = case_values[i] - lowest_value;
+    has_case[entry] = true;
+    setReachable(was_reachable);
+    vm_writer_->writeLabel(table_label + "_" + std::to_string(entry));
+    compileScopedStatements(if_tag);
+    vm_writer_->writeGoTo(end_label);
+    reaches_end = reaches_end || is_reachable_;
+  }
+
+  // The entries without a case, and a key outside the table, go to the
+  // final else.
+  setReachable(was_reachable);
+  for (int entry = 0; entry < n_entries; entry++) {
+    if (!has_case[entry]) {
+      vm_writer_->writeLabel(table_label + "_" + std::to_string(entry));
+    }
+  }
+  vm_writer_->writeLabel(default_label);
+  if (currentTokenIsExpectedKeyword(Keyword::Type::ELSE)) {
+    nextToken();
+    compileScopedStatements(else_tag);
+  }
+  for (size_t i = 1; i < case_values.size(); i++) {
+    handleClosingParenthesis('}', else_tag);
+  }
+  setReachable(reaches_end || is_reachable_);
+  vm_writer_->writeLabel(end_label);
+}
+
 void CompilationEngine::compileWhile() {
   label_count_++;
   std::string while_label = constructOutputLabel("WHILE_LOOP");
-  std::string end_label = constructOutputLabel("ENDLOOP");
-  vm_writer_->writeLabel(while_label);
+  std::string condition_label = constructOutputLabel("WHILE_CONDITION");
   const std::string while_tag = "whileStatement";
+  bool was_reachable = is_reachable_;
 
   // We know the first word is `while` as that is the precondition for entering
   // this method. So just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
+
+  Expression* condition = parseStatementCondition(while_tag);
+  if ((condition->type == ExpressionType::INT_CONST) &&
+      (condition->value != -1)) {
+    // The loop never runs, as only true (-1) holds, so its statements are
+    // checked but not written.
+    setReachable(false);
+    compileScopedStatements(while_tag);
+    setReachable(was_reachable);
+    return;
+  }
 
-  compileStatementCondition(while_tag);
+  bool is_endless = (condition->type == ExpressionType::INT_CONST);
+  if (is_endless) {
+    // The statements run forever, going back to the top of the loop
+    // unconditionally. Jack has no `break`, so nothing follows an endless
+    // loop.
+    vm_writer_->writeLabel(while_label);
+    compileScopedStatements(while_tag);
+    vm_writer_->writeGoTo(while_label);
+    setReachable(false);
+    return;
+  }
 
-  // We have compiled the statement condition so it is the top element on the
-  // stack. Now we not it, and if the not is true it means the condition is
-  // false so we go to the end of the loop.
-  vm_writer_->writeArithmetic(OpCommand::NOT);
-  vm_writer_->writeIfGoTo(end_label);
+  // The parts of the condition the statements cannot change are computed
+  // once, before the loop, into locals that are free again after it.
+  int n_outer_hoisted_locals = n_hoisted_locals_;
+  if (is_reachable_ && !HasSideEffects(condition)) {
+    hoistLoopInvariants(&condition, scanLoopStatements());
+  }
 
+  // The condition is tested at the bottom of the loop, so that each
+  // iteration only takes the jump back to the top while the condition holds,
+  // rather than a jump out of the loop and a jump back. The first test is
+  // reached by jumping over the statements. The condition was parsed before
+  // the statements, but its tree lasts until the end of the subroutine.
+  vm_writer_->writeGoTo(condition_label);
+  vm_writer_->writeLabel(while_label);
   compileScopedStatements(while_tag);
 
-  // At the end of the while statements, we go back to the top of the loop,
-  // unconditionally.
-  vm_writer_->writeGoTo(while_label);
-
-  // After the while loop, need to write the end label so we can skip entering
-  // the iteration when the condition is false.
-  vm_writer_->writeLabel(end_label);
+  setReachable(was_reachable);
+  vm_writer_->writeLabel(condition_label);
+  writeConditionalJump(condition, /*jump_if_true=*/true, while_label);
+  n_hoisted_locals_ = n_outer_hoisted_locals;
   return;
 }
 
@@ -306,134 +554,149 @@ void CompilationEngine::compileDo() {
 
   // We know the first word is `do` as this is the precondition for entering
   // this method. So just advance past it.
-  tokenizer_->nextToken();
+  nextToken();
+
+  // A static array is only called on by `do varName.dispose();`, as checked
+  // by findStaticArrays. Its block is given up rather than disposed of, unless
+  // the array was allocated by a reentered call.
+  const StaticArray* static_array = nullptr;
+  std::string dispose_label;
+  std::string disposed_label;
+  if (getTokenType() == TokenType::IDENTIFIER) {
+    static_array = getStaticArray(scope_list_.getVarData(getTokenId()));
+  }
+  if (static_array != nullptr) {
+    label_count_++;
+    dispose_label = constructOutputLabel("DISPOSE_ARRAY");
+    disposed_label = constructOutputLabel("ARRAY_DISPOSED");
+    writeStaticArrayRelease(*static_array, dispose_label);
+    vm_writer_->writeGoTo(disposed_label);
+    vm_writer_->writeLabel(dispose_label);
+  }
 
-  // compile the subroutine call. We put the subroutine name into
-  // `function_name`, calculate the number of expressions it is called on,
-  // and then compile the subroutine call statement to VM code.
-  std::stringstream function_name;
-  int n_args = compileSubroutineCall(&function_name);
-  vm_writer_->writeCall(function_name.str(), n_args);
+  // parse the subroutine call, folding the constants in its arguments.
+  Expression* call = FoldExpression(parseSubroutineCall());
 
   // Expect end of statement.
   handleStatementEnd(do_tag);
 
-  // With a do call we don't use the return value of the function but it is
-  // expected that it was pushed onto the stack, so we need to pop it off.
-  vm_writer_->writePop(Segment::TEMP, /*idx=*/0);
+  // An inlined setter, or a call of a subroutine returning no value, leaves
+  // nothing on the stack. Otherwise, with a do call we don't use the return
+  // value of the function but it is expected that it was pushed onto the
+  // stack, so we need to pop it off.
+  if (writeInlineSetterCall(call)) {
+    // the field has been assigned.
+  } else if ((call->type == ExpressionType::CALL) &&
+             returnsNoValue(call->function_name)) {
+    for (const Expression* argument : call->operands) {
+      writeExpression(argument);
+    }
+    vm_writer_->writeCallVoid(call->function_name, call->operands.size());
+  } else {
+    writeExpression(call);
+    if (options_.vm_extensions) {
+      vm_writer_->writeDrop();
+    } else {
+      vm_writer_->writePop(Segment::TEMP, /*idx=*/0);
+    }
+  }
+
+  if (static_array != nullptr) {
+    vm_writer_->writeLabel(disposed_label);
+  }
 
   return;
 }
 
-void CompilationEngine::compileTerm() {
+Expression* CompilationEngine::parseTerm() {
   const std::string term_tag = "term";
 
-  if (tokenizer_->getTokenType() == TokenType::SYMBOL) {
-    if (IsUnaryOp(tokenizer_->getSymbol())) {
-      // Keep track of the unary operator, compile the term, then add the VM
-      // command for the unary operator.
-      char unary_op = tokenizer_->getSymbol();
-      tokenizer_->nextToken();
-      compileTerm();
-      vm_writer_->writeArithmetic(GetUnaryOpCommand(unary_op));
-    } else if (tokenizer_->getSymbol() == '(') {
-      handleOpeningParenthesis('(', term_tag);
-      compileExpression();
-      handleClosingParenthesis(')', term_tag);
-    } else {
-      throw InvalidTerm(tokenizer_->tokenToString());
+  if (getTokenType() == TokenType::SYMBOL) {
+    if (IsUnaryOp(getSymbol())) {
+      // Keep track of the unary operator, which is applied to the term that
+      // follows it.
+      Expression* unary_op = expression_arena_.create(ExpressionType::UNARY_OP);
+      unary_op->value = getSymbol();
+      nextToken();
+      unary_op->operands.push_back(parseTerm());
+      return unary_op;
     }
-  } else if (currentTokenIsSimpleTerm()) {
-    compileSimpleTerm();
-    tokenizer_->nextToken();
-  } else {
-    // we must have an identifier. Either a simple variable name, an array
-    // element, or a subroutine call.
-    expectIdentifier();
-    std::string identifier_name = tokenizer_->tokenToString();
-    tokenizer_->nextToken();
-
-    if (currentTokenIsExpectedSymbol('[')) {
-      // We have an array, so we start by pushing the base address of the array
-      // onto the stack. That is, the array variable itself.
-      SymbolData arr_data = getVarData(identifier_name);
-      vm_writer_->writePush(arr_data.segment, /*idx=*/arr_data.offset);
-
-      handleOpeningParenthesis('[', term_tag);
-      // Compile the expression representing the index. This will be pushed onto
-      // the stack after the base address of the array.
-      compileExpression();
-      handleClosingParenthesis(']', term_tag);
-
-      // Add base address and index, which are the top 2 values on the stack.
-      vm_writer_->writeArithmetic(OpCommand::ADD);
-      // Pop the address into the THAT segment so that THAT 0 points to the
-      // corresponding array value and push that onto the stack.
-      vm_writer_->writePop(Segment::POINTER, 1);
-      vm_writer_->writePush(Segment::THAT, 0);
-    } else if (currentTokenIsExpectedSymbol('(')) {
-      // We have a subroutine call of the type `methodName(expressionList)`.
-      // So we write the subroutine name and then proceed with handling the
-      // brackets and expression list.
+    if (getSymbol() == '(') {
       handleOpeningParenthesis('(', term_tag);
-      int n_locals = compileExpressionList();
+      Expression* expression = parseExpression();
       handleClosingParenthesis(')', term_tag);
-      vm_writer_->writeCall(identifier_name, n_locals);
-    } else if (currentTokenIsExpectedSymbol('.')) {
-      // We have a subroutine call of the type
-      // `className.methodName(expressionList)`. Note that
-      // `methodName(expressionList)` has the form of a subroutine call.
-      tokenizer_->nextToken();
-
-      // Add the class name and `.` to the stream, then compile the rest of
-      // the subroutine call.
-      std::stringstream function_name;
-      int n_args = 0;
-      handleSymbolDataForSubroutine(&function_name, &n_args, identifier_name);
-      n_args += compileSubroutineCall(&function_name);
-      vm_writer_->writeCall(function_name.str(), n_args);
-    } else {
-      // We just have a simple variable.
-      SymbolData var_data = getVarData(identifier_name);
-      vm_writer_->writePush(var_data.segment, /*idx=*/var_data.offset);
+      return expression;
     }
+    throw InvalidTerm(tokenToString());
+  }
+  if (currentTokenIsSimpleTerm()) {
+    Expression* simple_term = parseSimpleTerm();
+    nextToken();
+    return simple_term;
   }
-  return;
-}
 
-void CompilationEngine::compileExpression() {
-  const std::string expression_tag = "expression";
+  // we must have an identifier. Either a simple variable name, an array
+  // element, or a subroutine call of the form `subroutineName(...)` or
+  // `name.subroutineName(...)`.
+  expectIdentifier();
+  if (nextTokenIsExpectedSymbol('(') || nextTokenIsExpectedSymbol('.')) {
+    return parseSubroutineCall();
+  }
+  const SymbolData& var_data = getVarData(getTokenId());
+  nextToken();
+
+  if (currentTokenIsExpectedSymbol('[')) {
+    // We have an array element, whose index is the expression between the
+    // brackets.
+    Expression* element =
+      expression_arena_.create(ExpressionType::ARRAY_ELEMENT);
+    element->segment = var_data.segment;
+    element->offset = var_data.offset;
+    handleOpeningParenthesis('[', term_tag);
+    element->operands.push_back(parseExpression());
+    handleClosingParenthesis(']', term_tag);
+    return element;
+  }
+
+  // We just have a simple variable.
+  Expression* variable = expression_arena_.create(ExpressionType::VARIABLE);
+  variable->segment = var_data.segment;
+  variable->offset = var_data.offset;
+  return variable;
+}
 
+Expression* CompilationEngine::parseExpression() {
   // We start with a term.
-  compileTerm();
+  Expression* expression = parseTerm();
 
   // Then we check for a binary op to tell us there are more terms in the
-  // expression.
+  // expression. Jack has no operator precedence, so each operator applies to
+  // everything to its left.
   while (currentTokenIsBinaryOp()) {
-    char binary_op = tokenizer_->getSymbol();
-    tokenizer_->nextToken();
-    compileTerm();
-    if (IsMathOp(binary_op)) {
-      vm_writer_->writeCall(GetMathOpFunction(binary_op), 2);
-    } else {
-      vm_writer_->writeArithmetic(GetSimpleBinaryOpCommand(binary_op));
-    }
+    Expression* binary_op = expression_arena_.create(ExpressionType::BINARY_OP);
+    binary_op->value = getSymbol();
+    nextToken();
+    binary_op->operands.push_back(expression);
+    binary_op->operands.push_back(parseTerm());
+    expression = binary_op;
   }
-  return;
+  return expression;
 }
 
-int CompilationEngine::compileExpressionList() {
-  int num_expressions = 0;
+void CompilationEngine::compileExpression() {
+  writeExpression(FoldExpression(parseExpression()));
+}
+
+void CompilationEngine::parseExpressionList(Expression* call) {
   const std::string expression_list_tag = "expressionList";
 
   // We have an empty parameter list `()`.
   if (currentTokenIsExpectedSymbol(')')) {
-    return num_expressions;
+    return;
   }
 
   // expect an expression.
-  num_expressions++;
-  compileExpression();
+  call->operands.push_back(parseExpression());
 
   // Check for more elements in the expression list. Either we have hit the end
   // of the list (signified by `)`) or we get a `,` signifying more parameters.
@@ -441,40 +704,42 @@ int CompilationEngine::compileExpressionList() {
     // we have another expression.
     if (currentTokenIsExpectedSymbol(',')) {
       // Advance past the `,`.
-      tokenizer_->nextToken();
+      nextToken();
 
       // Expect an expression.
-      num_expressions++;
-      compileExpression();
+      call->operands.push_back(parseExpression());
     } else {
       throw ExpectedClosingParenthesis(
-        tokenizer_->tokenToString(), ")", expression_list_tag);
+        tokenToString(), ")", expression_list_tag);
     }
   }
-  return num_expressions;
+  return;
 }
 
 void CompilationEngine::compileSubroutineDec() {
-  scope_list_->startSubroutine();
+  scope_list_.startSubroutine();
+  expression_arena_.clear();
   const std::string subroutine_tag = "subroutineDec";
+  bool uses_string_pool =
+    options_.string_pool && subroutineHasStringConstant();
 
   Keyword::Type dec_keyword = getSubroutineDecKeyword();
-  tokenizer_->nextToken();
+  nextToken();
 
   expectFunctionReturnType();
-  tokenizer_->nextToken();
+  nextToken();
 
   // Expect a valid identifier for the subroutine name.
   expectIdentifier();
   std::string function_name = constructFunctionNameFromCurrToken();
-  tokenizer_->nextToken();
+  nextToken();
 
   // If the current subroutine is a method we need to add `this` to the
   // subroutine level symbol table as the first argument.
   if (dec_keyword == Keyword::Type::METHOD) {
-    scope_list_->define(/*var_name=*/"this",
-                        /*var_type=*/curr_class_,
-                        /*var_segment=*/Segment::ARGUMENT);
+    scope_list_.define(/*var_id=*/string_table_.intern("this"),
+                       /*type_id=*/curr_class_id_,
+                       /*var_segment=*/Segment::ARGUMENT);
   }
 
   // Now we expect a parameter list enclosed in `(` and `)`.
@@ -483,32 +748,43 @@ void CompilationEngine::compileSubroutineDec() {
   handleClosingParenthesis(')', subroutine_tag);
 
   // Lastly we compile the body of the subroutine.
-  compileSubroutineBody(function_name, dec_keyword);
+  compileSubroutineBody(function_name, dec_keyword, uses_string_pool);
   return;
 }
 
 void CompilationEngine::compileSubroutineBody(
-  std::string subroutine_name, Keyword::Type dec_keyword) {
+  std::string subroutine_name, Keyword::Type dec_keyword,
+  bool uses_string_pool) {
   const std::string subroutine_tag = "subroutineBody";
 
   handleOpeningParenthesis('{', subroutine_tag);
 
   while (currentTokenIsExpectedKeyword(Keyword::Type::VAR)) {
     compileVarDec();
-    tokenizer_->nextToken();
+    nextToken();
   }
 
-  // The number of local variables for the function.
-  int n_locals = scope_list_->varCount(Segment::LOCAL);
+  // The number of local variables for the function. Locals holding values
+  // hoisted out of loops are added as they are needed.
+  int n_locals = scope_list_.varCount(Segment::LOCAL);
+  n_hoisted_locals_ = 0;
+  max_hoisted_locals_ = 0;
+  findStaticArrays();
+  returns_no_value_ = returnsNoValue(subroutine_name);
+  setReachable(true);
   vm_writer_->writeFunction(subroutine_name, n_locals);
 
   compileSubroutineInitCode(dec_keyword);
+  if (uses_string_pool) {
+    writeStringPoolCheck();
+  }
 
   if (currentTokenIsStatementKeyword()) {
     compileStatements();
   }
 
   handleClosingParenthesis('}', subroutine_tag);
+  setReachable(true);
   return;
 }
 
@@ -516,7 +792,7 @@ void CompilationEngine::compileSubroutineInitCode(Keyword::Type dec_keyword) {
   if (dec_keyword == Keyword::Type::CONSTRUCTOR) {
     // Push the number of class attributes onto the stack and allocate the
     // amount of memory needed for those attributes.
-    int n_attributes = scope_list_->varCount(Segment::THIS);
+    int n_attributes = scope_list_.varCount(Segment::THIS);
     vm_writer_->writePush(Segment::CONSTANT, n_attributes);
     vm_writer_->writeCall("Memory.alloc", 1);
 
@@ -533,80 +809,189 @@ void CompilationEngine::compileSubroutineInitCode(Keyword::Type dec_keyword) {
 }
 
 void CompilationEngine::setJackFile(std::string jack_file) {
-  tokenizer_ = std::make_unique<Tokenizer>(jack_file);
-  vm_writer_ = std::make_unique<VMWriter>(jack_file);
+  // The whole file is lexed up front, after which the tokenizer and its
+  // mapping of the file are no longer needed.
+  string_table_.clear();
+  {
+    Tokenizer tokenizer(jack_file);
+    tokens_.lex(&tokenizer, &string_table_);
+  }
+  token_idx_ = 0;
+  vm_writer_ = std::make_unique<VMWriter>(jack_file, options_.vm_extensions);
   label_count_ = 0;
 }
 
 // A subroutine call has one of 2 forms: `subroutineName(expressionList)` or
-// `className.subroutineName(expressionList)`.
-int CompilationEngine::compileSubroutineCall(
-  std::stringstream* function_name) {
+// `name.subroutineName(expressionList)`, where `name` is a class or variable.
+Expression* CompilationEngine::parseSubroutineCall() {
   const std::string call_tag = "subroutineCall";
-  // The number of arguments to the subroutine.
-  int n_args = 0;
+  Expression* call = expression_arena_.create(ExpressionType::CALL);
+  std::stringstream function_name;
 
   // expect an identifier (either `subroutineName`, `varName`, or `className`).
   expectIdentifier();
-  std::string identifier_name = tokenizer_->tokenToString();
-  tokenizer_->nextToken();
+  int identifier_id = getTokenId();
+  nextToken();
 
-  // This means we are in the second case. So we handle the identifier
-  // representing a variable or class name. Then we handle the subroutine name.
   if (currentTokenIsExpectedSymbol('.')) {
-    handleSymbolDataForSubroutine(function_name, &n_args, identifier_name);
+    const SymbolData& var_data = scope_list_.getVarData(identifier_id);
+    if (var_data.segment == Segment::UNKNOWN) {
+      // We have a class name, so stream the class name and the `.`
+      function_name << string_table_.getString(identifier_id) << '.';
+    } else {
+      // We have the form `varName.subroutineName(...)` so the `varName` is
+      // the first argument to the subroutine and its type is the class of
+      // the subroutine.
+      Expression* object = expression_arena_.create(ExpressionType::VARIABLE);
+      object->segment = var_data.segment;
+      object->offset = var_data.offset;
+      call->operands.push_back(object);
+      function_name << string_table_.getString(var_data.type_id) << '.';
+    }
 
     // Advance past the `.`. And assign the subroutine name to the identifier.
-    tokenizer_->nextToken();
-    identifier_name = tokenizer_->tokenToString();
-    tokenizer_->nextToken();
+    nextToken();
+    identifier_id = getTokenId();
+    nextToken();
   } else {
-    // We have a plain subroutine call. If the stream is currently empty then
-    // it is calling a subroutine in the same class. Otherwise, the call arises
-    // from a let statement, so the call has already been added. Note that
-    // the subroutine implicitly refers to the current object, which is this.
-    // (ie. if the call is `subroutine(x, y)` inside the `Obj` class then
-    // the call is implicitly `this.subroutine(x, y)` which should be translated
-    // to `Obj.subroutine(this, x, y)`).
-    if (function_name->rdbuf()->in_avail() == 0) {
-      (*function_name) << curr_class_ << '.';
-      // Pushing the first argument `this` onto the stack.
-      vm_writer_->writePush(Segment::POINTER, 0);
-      n_args += 1;
-    }
+    // We have a plain subroutine call, which implicitly refers to the current
+    // object. (ie. if the call is `subroutine(x, y)` inside the `Obj` class
+    // then the call is implicitly `this.subroutine(x, y)` which should be
+    // translated to `Obj.subroutine(this, x, y)`).
+    function_name << curr_class_ << '.';
+    Expression* object = expression_arena_.create(ExpressionType::VARIABLE);
+    object->segment = Segment::POINTER;
+    object->offset = 0;
+    call->operands.push_back(object);
   }
 
   // Now we add the subroutine name to the stream.
-  (*function_name) << identifier_name;
+  function_name << string_table_.getString(identifier_id);
+  call->function_name = function_name.str();
 
-  // Now compile the expression list.
+  // Now parse the expression list.
   handleOpeningParenthesis('(', call_tag);
-  n_args += compileExpressionList();
+  parseExpressionList(call);
   handleClosingParenthesis(')', call_tag);
 
-  return n_args;
+  // In whole-program mode, the arguments are checked against the declaration
+  // of any subroutine of the program.
+  const SubroutineInfo* callee = (program_index_ == nullptr) ?
+    nullptr : program_index_->findSubroutine(call->function_name);
+  if (callee != nullptr) {
+    int n_args = callee->n_parameters +
+      ((callee->kind == Keyword::Type::METHOD) ? 1 : 0);
+    if (static_cast<int>(call->operands.size()) != n_args) {
+      throw WrongArgumentCount(
+        call->function_name, n_args, call->operands.size());
+    }
+  }
+
+  return inlineGetterCall(call);
+}
+
+bool CompilationEngine::returnsNoValue(const std::string& function_name) {
+  if ((program_index_ == nullptr) || !options_.vm_extensions ||
+      (function_name.compare(entry_point_name) == 0)) {
+    return false;
+  }
+  const SubroutineInfo* subroutine =
+    program_index_->findSubroutine(function_name);
+  return (subroutine != nullptr) && subroutine->returns_void;
+}
+
+// Determines if the receiver of a method call can be read again in place of
+// the call. Only a variable can be, as any other expression, such as an array
+// entry passed with the `Class.method(object)` syntax, is no address to read
+// the field through.
+static bool isInlinableReceiver(const Expression* object) {
+  return object->type == ExpressionType::VARIABLE;
+}
+
+// Creates the expression for field `field_idx` of `object`, the variable a
+// method is called on. The field of another object is an entry of it, and a
+// field of the current object is a variable of `this`.
+static Expression* createFieldExpression(
+  ExpressionArena* expression_arena, const Expression* object, int field_idx) {
+  if ((object->segment == Segment::POINTER) && (object->offset == 0)) {
+    Expression* field = expression_arena->create(ExpressionType::VARIABLE);
+    field->segment = Segment::THIS;
+    field->offset = field_idx;
+    return field;
+  }
+  Expression* field = expression_arena->create(ExpressionType::ARRAY_ELEMENT);
+  field->segment = object->segment;
+  field->offset = object->offset;
+  Expression* index = expression_arena->create(ExpressionType::INT_CONST);
+  index->value = field_idx;
+  field->operands.push_back(index);
+  return field;
+}
+
+Expression* CompilationEngine::inlineGetterCall(Expression* call) {
+  if (program_index_ == nullptr) {
+    return call;
+  }
+  const SubroutineInfo* callee =
+    program_index_->findSubroutine(call->function_name);
+  if ((callee == nullptr) || (callee->inline_kind != InlineKind::GETTER) ||
+      (call->operands.size() != 1) ||
+      !isInlinableReceiver(call->operands[0])) {
+    return call;
+  }
+
+  return createFieldExpression(
+    &expression_arena_, call->operands[0], callee->field_idx);
+}
+
+bool CompilationEngine::writeInlineSetterCall(const Expression* call) {
+  if ((program_index_ == nullptr) || (call->type != ExpressionType::CALL)) {
+    return false;
+  }
+  const SubroutineInfo* callee =
+    program_index_->findSubroutine(call->function_name);
+  if ((callee == nullptr) || (callee->inline_kind != InlineKind::SETTER) ||
+      (call->operands.size() != 2) ||
+      !isInlinableReceiver(call->operands[0])) {
+    return false;
+  }
+
+  Expression* field = createFieldExpression(
+    &expression_arena_, call->operands[0], callee->field_idx);
+  if (field->type == ExpressionType::VARIABLE) {
+    writeExpression(call->operands[1]);
+    vm_writer_->writePop(field->segment, field->offset);
+  } else {
+    writeArrayStore(field, call->operands[1]);
+  }
+  return true;
 }
 
 void CompilationEngine::compileAdditionalVarDecs(
-  std::string var_type, Segment var_segment, const std::string compile_tag) {
+  int var_type, Segment var_segment, const std::string compile_tag) {
   while (!currentTokenIsExpectedSymbol(';')) {
     if (currentTokenIsExpectedSymbol(',')) {
-      tokenizer_->nextToken();
+      nextToken();
 
       handleVariableDefinition(var_type, var_segment);
     } else {
-      throw ExpectedStatementEnd(tokenizer_->tokenToString(), compile_tag);
+      throw ExpectedStatementEnd(tokenToString(), compile_tag);
     }
   }
   return;
 }
 
-void CompilationEngine::compileStatementCondition(
+Expression* CompilationEngine::parseStatementCondition(
   const std::string compile_tag) {
   handleOpeningParenthesis('(', compile_tag);
-  compileExpression();
+  Expression* condition = FoldExpression(parseExpression());
   handleClosingParenthesis(')', compile_tag);
-  return;
+  return condition;
+}
+
+void CompilationEngine::setReachable(bool is_reachable) {
+  is_reachable_ = is_reachable;
+  vm_writer_->setSuppressed(!is_reachable);
 }
 
 void CompilationEngine::compileScopedStatements(const std::string compile_tag) {
@@ -616,38 +1001,36 @@ void CompilationEngine::compileScopedStatements(const std::string compile_tag) {
   return;
 }
 
-void CompilationEngine::compileKeywordConstant() {
-  switch (tokenizer_->getKeyword()) {
-    case Keyword::Type::TRUE:
-      vm_writer_->writePush(Segment::CONSTANT, 1);
-      vm_writer_->writeArithmetic(OpCommand::NEG);
-      return;
-    case Keyword::Type::FALSE:
-    case Keyword::Type::NULL_VAL:
-      vm_writer_->writePush(Segment::CONSTANT, 0);
-      return;
-    case Keyword::Type::THIS:
-      vm_writer_->writePush(Segment::POINTER, 0);
-    default:
-      return;
+Expression* CompilationEngine::parseKeywordConstant() {
+  if (getKeyword() == Keyword::Type::THIS) {
+    Expression* this_pointer =
+      expression_arena_.create(ExpressionType::VARIABLE);
+    this_pointer->segment = Segment::POINTER;
+    this_pointer->offset = 0;
+    return this_pointer;
   }
+
+  // `true` is -1, and both `false` and `null` are 0.
+  Expression* constant = expression_arena_.create(ExpressionType::INT_CONST);
+  constant->value = (getKeyword() == Keyword::Type::TRUE) ? -1 : 0;
+  return constant;
 }
 
-void CompilationEngine::compileRightSideOfEquation(std::string compile_tag) {
+Expression* CompilationEngine::parseRightSideOfEquation(
+  std::string compile_tag) {
   // First, we expect to have an equal sign.
   if (!currentTokenIsExpectedSymbol('=')) {
-    throw ExpectedSymbol(tokenizer_->tokenToString(), "=", compile_tag);
+    throw ExpectedSymbol(tokenToString(), "=", compile_tag);
   }
 
-  tokenizer_->nextToken();
+  nextToken();
 
-  // Handle the expression on the right of the `=`. The VM commands for the
-  // expression will store the result of the expression on the stack.
-  compileExpression();
+  // Handle the expression on the right of the `=`, folding its constants.
+  return FoldExpression(parseExpression());
 }
 
-void CompilationEngine::compileStringConstant() {
-  std::string string_const = tokenizer_->getStringVal();
+void CompilationEngine::writeStringConstant(int string_id) {
+  const std::string& string_const = string_table_.getString(string_id);
 
   // We start by allocating enough space for the string.
   vm_writer_->writePush(Segment::CONSTANT, string_const.length());
@@ -660,89 +1043,761 @@ void CompilationEngine::compileStringConstant() {
   }
 }
 
-SymbolData CompilationEngine::getVarData(std::string var_name) {
-  SymbolData var_data = scope_list_->getVarData(var_name);
+int CompilationEngine::allocateHiddenStatic() {
+  return scope_list_.varCount(Segment::STATIC) + n_hidden_statics_++;
+}
+
+int CompilationEngine::getStringPoolSlot(int string_id) {
+  for (size_t i = 0; i < pooled_strings_.size(); i++) {
+    if (pooled_strings_[i] == string_id) {
+      return pooled_string_statics_[i];
+    }
+  }
+  // the first string goes in the static checked by the subroutines using
+  // the pool.
+  if (pooled_strings_.empty() && (string_pool_ready_static_ >= 0)) {
+    pooled_string_statics_.push_back(string_pool_ready_static_);
+  } else {
+    pooled_string_statics_.push_back(allocateHiddenStatic());
+  }
+  pooled_strings_.push_back(string_id);
+  return pooled_string_statics_.back();
+}
+
+void CompilationEngine::writeStringPoolCheck() {
+  // The first string of the pool is not null once the pool is built, as
+  // the init function builds every string at once.
+  if (string_pool_ready_static_ < 0) {
+    string_pool_ready_static_ = allocateHiddenStatic();
+  }
+  label_count_++;
+  std::string ready_label = constructOutputLabel("STRINGS_READY");
+  vm_writer_->writePush(Segment::STATIC, string_pool_ready_static_);
+  vm_writer_->writeIfGoTo(ready_label);
+  vm_writer_->writeCall(curr_class_ + "." + string_pool_init_name, 0);
+  if (options_.vm_extensions) {
+    vm_writer_->writeDrop();
+  } else {
+    vm_writer_->writePop(Segment::TEMP, 0);
+  }
+  vm_writer_->writeLabel(ready_label);
+}
+
+void CompilationEngine::writeStringPoolInit() {
+  vm_writer_->writeFunction(curr_class_ + "." + string_pool_init_name, 0);
+  for (size_t i = 0; i < pooled_strings_.size(); i++) {
+    writeStringConstant(pooled_strings_[i]);
+    vm_writer_->writePop(Segment::STATIC, pooled_string_statics_[i]);
+  }
+  vm_writer_->writePush(Segment::CONSTANT, 0);
+  vm_writer_->writeReturn();
+}
+
+bool CompilationEngine::subroutineHasStringConstant() {
+  // No subroutine declaration keyword can appear inside a subroutine, so the
+  // subroutine ends before the next one.
+  for (size_t i = token_idx_ + 1; i < tokens_.size(); i++) {
+    TokenType token_type = tokens_.getType(i);
+    if (token_type == TokenType::STRING_CONST) {
+      return true;
+    }
+    if (token_type == TokenType::KEYWORD) {
+      Keyword::Type keyword = tokens_.getKeyword(i);
+      if ((keyword == Keyword::Type::FUNCTION) ||
+          (keyword == Keyword::Type::METHOD) ||
+          (keyword == Keyword::Type::CONSTRUCTOR) ||
+          (keyword == Keyword::Type::CLASS)) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+void CompilationEngine::writeIntConstant(int value) {
+  // Only non negative constants can be pushed, so a negative constant is
+  // pushed as the negation, or for -32768 the complement, of one.
+  if (value >= 0) {
+    vm_writer_->writePush(Segment::CONSTANT, value);
+  } else if (value == -32768) {
+    vm_writer_->writePush(Segment::CONSTANT, 32767);
+    vm_writer_->writeArithmetic(OpCommand::NOT);
+  } else {
+    vm_writer_->writePush(Segment::CONSTANT, -value);
+    vm_writer_->writeArithmetic(OpCommand::NEG);
+  }
+}
+
+void CompilationEngine::writeExpression(const Expression* expression) {
+  switch (expression->type) {
+    case ExpressionType::INT_CONST:
+      writeIntConstant(expression->value);
+      return;
+    case ExpressionType::STRING_CONST:
+      if (options_.string_pool) {
+        vm_writer_->writePush(
+          Segment::STATIC, getStringPoolSlot(expression->value));
+      } else {
+        writeStringConstant(expression->value);
+      }
+      return;
+    case ExpressionType::VARIABLE:
+      vm_writer_->writePush(expression->segment, expression->offset);
+      return;
+    case ExpressionType::ARRAY_ELEMENT: {
+      ThatAddress address;
+      int that_idx;
+      if (getThatAddress(expression, &address, &that_idx)) {
+        // Read the element through THAT, which may already point at it.
+        writeThatAddress(address);
+        vm_writer_->writePush(Segment::THAT, that_idx);
+        return;
+      }
+
+      // Push the base address of the array and then the index, and add them
+      // to get the address of the element.
+      vm_writer_->writePush(expression->segment, expression->offset);
+      writeExpression(expression->operands[0]);
+      vm_writer_->writeArithmetic(OpCommand::ADD);
+      if (options_.vm_extensions) {
+        // Replace the address with the array value it points to.
+        vm_writer_->writeLoad();
+      } else {
+        // Pop the address into the THAT segment so that THAT 0 points to the
+        // corresponding array value and push that onto the stack.
+        vm_writer_->writePop(Segment::POINTER, 1);
+        vm_writer_->writePush(Segment::THAT, 0);
+      }
+      return;
+    }
+    case ExpressionType::CALL:
+      for (const Expression* argument : expression->operands) {
+        writeExpression(argument);
+      }
+      // a subroutine returning no value gives 0, as `return;` would.
+      if (returnsNoValue(expression->function_name)) {
+        vm_writer_->writeCallVoid(
+          expression->function_name, expression->operands.size());
+        vm_writer_->writePush(Segment::CONSTANT, 0);
+        return;
+      }
+      vm_writer_->writeCall(
+        expression->function_name, expression->operands.size());
+      return;
+    case ExpressionType::UNARY_OP:
+      writeExpression(expression->operands[0]);
+      vm_writer_->writeArithmetic(GetUnaryOpCommand(expression->value));
+      return;
+    case ExpressionType::BINARY_OP:
+      if (expression->value == '*') {
+        // A multiplication by a constant is written as additions, which is
+        // much cheaper than calling Math.multiply.
+        if (expression->operands[1]->type == ExpressionType::INT_CONST) {
+          writeMultiplyByConstant(
+            expression->operands[0], expression->operands[1]->value);
+          return;
+        }
+        if (expression->operands[0]->type == ExpressionType::INT_CONST) {
+          writeMultiplyByConstant(
+            expression->operands[1], expression->operands[0]->value);
+          return;
+        }
+      }
+      writeExpression(expression->operands[0]);
+      writeExpression(expression->operands[1]);
+      if (IsMathOp(expression->value)) {
+        vm_writer_->writeCall(GetMathOpFunction(expression->value), 2);
+      } else {
+        vm_writer_->writeArithmetic(
+          GetSimpleBinaryOpCommand(expression->value));
+      }
+      return;
+  }
+}
+
+void CompilationEngine::writeConditionalJump(
+  const Expression* condition, bool jump_if_true, const std::string& label) {
+  if ((condition->type == ExpressionType::UNARY_OP) &&
+      (condition->value == '~') &&
+      IsBooleanExpression(condition->operands[0])) {
+    // `~` of a boolean swaps true and false, so jump on the other outcome.
+    writeConditionalJump(condition->operands[0], !jump_if_true, label);
+    return;
+  }
+  if ((condition->type == ExpressionType::BINARY_OP) &&
+      ((condition->value == '&') || (condition->value == '|')) &&
+      IsBooleanExpression(condition) &&
+      !HasSideEffects(condition->operands[1])) {
+    // The right operand is skipped once the left one settles the outcome,
+    // which is only done if evaluating it does nothing but compute a value.
+    const Expression* left = condition->operands[0];
+    const Expression* right = condition->operands[1];
+    bool is_and = (condition->value == '&');
+    if (jump_if_true != is_and) {
+      // `&` is false, and `|` is true, as soon as either operand is.
+      writeConditionalJump(left, jump_if_true, label);
+      writeConditionalJump(right, jump_if_true, label);
+    } else {
+      label_count_++;
+      std::string skip_label = constructOutputLabel("SKIP_CONDITION");
+      writeConditionalJump(left, !jump_if_true, skip_label);
+      writeConditionalJump(right, jump_if_true, label);
+      vm_writer_->writeLabel(skip_label);
+    }
+    return;
+  }
+
+  if (!jump_if_true && options_.vm_extensions &&
+      (condition->type == ExpressionType::BINARY_OP) &&
+      IsComparisonOp(condition->value)) {
+    // Jump on the negated comparison, such as `ge` for `<`.
+    writeExpression(condition->operands[0]);
+    writeExpression(condition->operands[1]);
+    vm_writer_->writeArithmetic(GetNegatedComparisonCommand(condition->value));
+    vm_writer_->writeIfGoTo(label);
+    return;
+  }
+
+  // Otherwise, the boolean is computed and negated if the jump is on false.
+  // The VMTranslator turns a comparison followed by the `not` and the
+  // `if-goto` into a single jump.
+  writeExpression(condition);
+  if (!jump_if_true) {
+    vm_writer_->writeArithmetic(OpCommand::NOT);
+  } else if (!IsBooleanExpression(condition)) {
+    // A condition only holds if `not` turns it into 0, that is if it is -1,
+    // so any other value does not jump.
+    writeIntConstant(-1);
+    vm_writer_->writeArithmetic(OpCommand::EQ);
+  }
+  vm_writer_->writeIfGoTo(label);
+}
+
+LoopEffects CompilationEngine::scanLoopStatements() {
+  LoopEffects effects;
+  effects.writes_arrays = false;
+  effects.calls = false;
+  int depth = 0;
+  for (size_t i = token_idx_; i < tokens_.size(); i++) {
+    TokenType token_type = tokens_.getType(i);
+    if (token_type == TokenType::UNKNOWN) {
+      break;
+    }
+    if (token_type == TokenType::STRING_CONST) {
+      // building a string calls the String class.
+      effects.calls = true;
+    } else if (token_type == TokenType::KEYWORD) {
+      Keyword::Type keyword = tokens_.getKeyword(i);
+      if (keyword == Keyword::Type::DO) {
+        effects.calls = true;
+      } else if ((keyword == Keyword::Type::LET) &&
+                 (tokens_.getType(i + 1) == TokenType::IDENTIFIER)) {
+        if ((tokens_.getType(i + 2) == TokenType::SYMBOL) &&
+            (tokens_.getSymbol(i + 2) == '[')) {
+          effects.writes_arrays = true;
+        } else {
+          const SymbolData& var_data =
+            scope_list_.getVarData(tokens_.getId(i + 1));
+          effects.assigned_vars.push_back(var_data);
+          // a field may also be read as an entry of another reference to
+          // the object, as an inlined getter does.
+          if (var_data.segment == Segment::THIS) {
+            effects.writes_arrays = true;
+          }
+        }
+      }
+    } else if (token_type == TokenType::SYMBOL) {
+      char symbol = tokens_.getSymbol(i);
+      if (symbol == '{') {
+        depth++;
+      } else if (symbol == '}') {
+        depth--;
+        if (depth == 0) {
+          break;
+        }
+      } else if ((symbol == '(') && (i > 0) &&
+                 (tokens_.getType(i - 1) == TokenType::IDENTIFIER)) {
+        // only the arguments of a call follow an identifier.
+        effects.calls = true;
+      }
+    }
+  }
+  return effects;
+}
+
+void CompilationEngine::findStaticArrays() {
+  static_arrays_.clear();
+  if (!options_.static_arrays) {
+    return;
+  }
+
+  // the size of the array created for each local, 0 if no creation has been
+  // found, or -1 if the local cannot hold a static array.
+  std::vector<int> sizes(scope_list_.varCount(Segment::LOCAL), 0);
+  int depth = 0;
+  for (size_t i = token_idx_; i < tokens_.size(); i++) {
+    TokenType token_type = tokens_.getType(i);
+    if (token_type == TokenType::UNKNOWN) {
+      break;
+    }
+    if (token_type == TokenType::SYMBOL) {
+      char symbol = tokens_.getSymbol(i);
+      if (symbol == '{') {
+        depth++;
+      } else if (symbol == '}') {
+        // the `}` closing the subroutine body.
+        if (depth == 0) {
+          break;
+        }
+        depth--;
+      }
+      continue;
+    }
+    // the name of a called subroutine follows a `.`.
+    if ((token_type != TokenType::IDENTIFIER) ||
+        tokens_.isSymbol(i - 1, '.')) {
+      continue;
+    }
+    const SymbolData& var_data = scope_list_.getVarData(tokens_.getId(i));
+    if ((var_data.segment != Segment::LOCAL) || (sizes[var_data.offset] < 0)) {
+      continue;
+    }
+    int* size = &sizes[var_data.offset];
+    if (tokens_.isSymbol(i + 1, '[')) {
+      continue;
+    }
+    bool is_creation = (*size == 0) &&
+      tokens_.isKeyword(i - 1, Keyword::Type::LET) &&
+      tokens_.isSymbol(i + 1, '=') &&
+      isIdentifierToken(tokens_, string_table_, i + 2, "Array") &&
+      tokens_.isSymbol(i + 3, '.') &&
+      isIdentifierToken(tokens_, string_table_, i + 4, "new") &&
+      tokens_.isSymbol(i + 5, '(') &&
+      (tokens_.getType(i + 6) == TokenType::INT_CONST) &&
+      tokens_.isSymbol(i + 7, ')') &&
+      tokens_.isSymbol(i + 8, ';');
+    if (is_creation && (tokens_.getIntVal(i + 6) > 0) &&
+        (tokens_.getIntVal(i + 6) <= max_static_array_size)) {
+      *size = tokens_.getIntVal(i + 6);
+      continue;
+    }
+    bool is_disposal = tokens_.isKeyword(i - 1, Keyword::Type::DO) &&
+      tokens_.isSymbol(i + 1, '.') &&
+      isIdentifierToken(tokens_, string_table_, i + 2, "dispose") &&
+      tokens_.isSymbol(i + 3, '(') &&
+      tokens_.isSymbol(i + 4, ')') &&
+      tokens_.isSymbol(i + 5, ';');
+    if (!is_disposal) {
+      // any other use may let the array leave the subroutine.
+      *size = -1;
+    }
+  }
+
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (sizes[i] > 0) {
+      StaticArray static_array;
+      static_array.local_idx = i;
+      static_array.size = sizes[i];
+      static_array.block_static = allocateHiddenStatic();
+      static_array.busy_static = allocateHiddenStatic();
+      static_arrays_.push_back(static_array);
+    }
+  }
+}
+
+// Creates the condition `varName = block`, which is true if the local of
+// `static_array` holds its block.
+static Expression* createHoldsBlockCondition(
+  ExpressionArena* expression_arena, const StaticArray& static_array) {
+  Expression* local = expression_arena->create(ExpressionType::VARIABLE);
+  local->segment = Segment::LOCAL;
+  local->offset = static_array.local_idx;
+  Expression* block = expression_arena->create(ExpressionType::VARIABLE);
+  block->segment = Segment::STATIC;
+  block->offset = static_array.block_static;
+  Expression* condition = expression_arena->create(ExpressionType::BINARY_OP);
+  condition->value = '=';
+  condition->operands.push_back(local);
+  condition->operands.push_back(block);
+  return condition;
+}
+
+const StaticArray* CompilationEngine::getStaticArray(
+  const SymbolData& var_data) {
+  if (var_data.segment != Segment::LOCAL) {
+    return nullptr;
+  }
+  for (const StaticArray& static_array : static_arrays_) {
+    if (static_array.local_idx == var_data.offset) {
+      return &static_array;
+    }
+  }
+  return nullptr;
+}
+
+void CompilationEngine::writeStaticArrayAllocation(
+  const StaticArray& static_array) {
+  label_count_++;
+  std::string busy_label = constructOutputLabel("ARRAY_BUSY");
+  std::string have_block_label = constructOutputLabel("HAVE_ARRAY");
+  std::string allocated_label = constructOutputLabel("ARRAY_ALLOCATED");
+
+  // take the block, allocating it on first use.
+  vm_writer_->writePush(Segment::STATIC, static_array.busy_static);
+  vm_writer_->writeIfGoTo(busy_label);
+  vm_writer_->writePush(Segment::STATIC, static_array.block_static);
+  vm_writer_->writeIfGoTo(have_block_label);
+  vm_writer_->writePush(Segment::CONSTANT, static_array.size);
+  vm_writer_->writeCall("Array.new", 1);
+  vm_writer_->writePop(Segment::STATIC, static_array.block_static);
+  vm_writer_->writeLabel(have_block_label);
+  writeIntConstant(-1);
+  vm_writer_->writePop(Segment::STATIC, static_array.busy_static);
+  vm_writer_->writePush(Segment::STATIC, static_array.block_static);
+  vm_writer_->writePop(Segment::LOCAL, static_array.local_idx);
+  vm_writer_->writeGoTo(allocated_label);
+
+  // The block is held. If this call holds it, the array is being created
+  // again and the old one can no longer be reached, so the block is kept.
+  // Otherwise a reentered call holds it and a new array is allocated.
+  vm_writer_->writeLabel(busy_label);
+  writeConditionalJump(
+    createHoldsBlockCondition(&expression_arena_, static_array),
+    /*jump_if_true=*/true, allocated_label);
+  vm_writer_->writePush(Segment::CONSTANT, static_array.size);
+  vm_writer_->writeCall("Array.new", 1);
+  vm_writer_->writePop(Segment::LOCAL, static_array.local_idx);
+  vm_writer_->writeLabel(allocated_label);
+}
+
+void CompilationEngine::writeStaticArrayRelease(
+  const StaticArray& static_array, const std::string& not_held_label) {
+  writeConditionalJump(
+    createHoldsBlockCondition(&expression_arena_, static_array),
+    /*jump_if_true=*/false, not_held_label);
+  vm_writer_->writePush(Segment::CONSTANT, 0);
+  vm_writer_->writePop(Segment::STATIC, static_array.busy_static);
+}
+
+bool CompilationEngine::isLoopInvariant(
+  const Expression* expression, const LoopEffects& effects) {
+  switch (expression->type) {
+    case ExpressionType::INT_CONST:
+      return true;
+    case ExpressionType::STRING_CONST:
+    case ExpressionType::CALL:
+      return false;
+    case ExpressionType::VARIABLE:
+    case ExpressionType::ARRAY_ELEMENT:
+      for (const SymbolData& var_data : effects.assigned_vars) {
+        if ((var_data.segment == expression->segment) &&
+            (var_data.offset == expression->offset)) {
+          return false;
+        }
+      }
+      // A called subroutine can change fields and statics, but not the
+      // locals and arguments of this one, nor which object `this` is.
+      if (effects.calls && (expression->segment != Segment::LOCAL) &&
+          (expression->segment != Segment::ARGUMENT) &&
+          (expression->segment != Segment::POINTER)) {
+        return false;
+      }
+      if (expression->type == ExpressionType::ARRAY_ELEMENT) {
+        return !effects.writes_arrays && !effects.calls &&
+          isLoopInvariant(expression->operands[0], effects);
+      }
+      return true;
+    case ExpressionType::UNARY_OP:
+    case ExpressionType::BINARY_OP:
+      for (const Expression* operand : expression->operands) {
+        if (!isLoopInvariant(operand, effects)) {
+          return false;
+        }
+      }
+      return true;
+  }
+  return false;
+}
+
+void CompilationEngine::hoistLoopInvariants(
+  Expression** slot, const LoopEffects& effects) {
+  Expression* expression = *slot;
+  if ((expression->type == ExpressionType::INT_CONST) ||
+      (expression->type == ExpressionType::VARIABLE)) {
+    // Reading a local is no cheaper than reading a constant or a variable.
+    return;
+  }
+  if (!isLoopInvariant(expression, effects)) {
+    for (size_t i = 0; i < expression->operands.size(); i++) {
+      hoistLoopInvariants(&expression->operands[i], effects);
+    }
+    return;
+  }
+
+  int local_idx = scope_list_.varCount(Segment::LOCAL) + n_hoisted_locals_;
+  n_hoisted_locals_++;
+  if (n_hoisted_locals_ > max_hoisted_locals_) {
+    max_hoisted_locals_ = n_hoisted_locals_;
+    vm_writer_->setLocalCount(local_idx + 1);
+  }
+  writeExpression(expression);
+  vm_writer_->writePop(Segment::LOCAL, local_idx);
+
+  Expression* hoisted_local =
+    expression_arena_.create(ExpressionType::VARIABLE);
+  hoisted_local->segment = Segment::LOCAL;
+  hoisted_local->offset = local_idx;
+  *slot = hoisted_local;
+}
+
+bool CompilationEngine::getThatAddress(
+  const Expression* element, ThatAddress* address, int* that_idx) {
+  const Expression* index = element->operands[0];
+  address->base_segment = element->segment;
+  address->base_idx = element->offset;
+  address->index_segment = Segment::UNKNOWN;
+  address->index_idx = 0;
+  *that_idx = 0;
+  if ((index->type == ExpressionType::INT_CONST) && (index->value >= 0)) {
+    // THAT points at the array itself, and the index is the THAT offset.
+    *that_idx = index->value;
+    return true;
+  }
+  if ((index->type == ExpressionType::VARIABLE) && !options_.vm_extensions) {
+    address->index_segment = index->segment;
+    address->index_idx = index->offset;
+    return true;
+  }
+  return false;
+}
+
+void CompilationEngine::writeThatAddress(const ThatAddress& address) {
+  if (vm_writer_->thatHolds(address)) {
+    return;
+  }
+  vm_writer_->writePush(address.base_segment, address.base_idx);
+  if (address.index_segment != Segment::UNKNOWN) {
+    vm_writer_->writePush(address.index_segment, address.index_idx);
+    vm_writer_->writeArithmetic(OpCommand::ADD);
+  }
+  vm_writer_->writePop(Segment::POINTER, 1);
+  vm_writer_->setThatAddress(address);
+}
+
+// Determines if the variables of `memory_segment` belong to the running
+// subroutine, so that no subroutine it calls can change them.
+static bool isStackSegment(Segment memory_segment) {
+  return (memory_segment == Segment::LOCAL) ||
+    (memory_segment == Segment::ARGUMENT);
+}
+
+void CompilationEngine::writeArrayStore(
+  const Expression* element, const Expression* value) {
+  const Expression* index = element->operands[0];
+  ThatAddress address;
+  int that_idx;
+  bool through_that = getThatAddress(element, &address, &that_idx);
+
+  // Jack evaluates the address before the value. The value is written
+  // first instead when neither can change what the other reads, which
+  // leaves the address free to be set last, straight into THAT.
+  bool value_first = !HasSideEffects(value) && !HasSideEffects(index);
+  if (through_that) {
+    value_first = !HasSideEffects(value) ||
+      (isStackSegment(address.base_segment) &&
+       ((address.index_segment == Segment::UNKNOWN) ||
+        isStackSegment(address.index_segment)));
+  }
+  if (value_first && through_that) {
+    writeExpression(value);
+    writeThatAddress(address);
+    vm_writer_->writePop(Segment::THAT, that_idx);
+    return;
+  }
+  if (value_first && !options_.vm_extensions) {
+    writeExpression(value);
+    vm_writer_->writePush(element->segment, element->offset);
+    writeExpression(index);
+    vm_writer_->writeArithmetic(OpCommand::ADD);
+    vm_writer_->writePop(Segment::POINTER, 1);
+    vm_writer_->writePop(Segment::THAT, 0);
+    return;
+  }
+
+  // Push the base address of the array and then the index, and add them to
+  // get the address of the entry.
+  vm_writer_->writePush(element->segment, element->offset);
+  writeExpression(index);
+  vm_writer_->writeArithmetic(OpCommand::ADD);
+  writeExpression(value);
+
+  if (options_.vm_extensions) {
+    // The stack holds the address of the array entry and then the value of
+    // the right hand side, which is exactly what `store` expects.
+    vm_writer_->writeStore();
+  } else {
+    // Pop the right hand side off the stack and into temp 0
+    vm_writer_->writePop(Segment::TEMP, 0);
+
+    // Now the top most value on the stack is the address of the array entry
+    // on the left hand side of the equation. So set the THAT segment to
+    // this address, push temp 0 back onto the stack and pop it into THAT 0
+    // which is the value of the array entry on the left hand side.
+    vm_writer_->writePop(Segment::POINTER, 1);
+    vm_writer_->writePush(Segment::TEMP, 0);
+    vm_writer_->writePop(Segment::THAT, 0);
+  }
+}
+
+void CompilationEngine::writeMultiplyByConstant(
+  const Expression* operand, int factor) {
+  // x * -c is -(x * c), except for -32768 whose 16 bit pattern is a single
+  // bit.
+  bool is_negative = (factor < 0) && (factor != -32768);
+  unsigned int bits = static_cast<uint16_t>(is_negative ? -factor : factor);
+  if (bits == 0) {
+    // Only reached if the operand has side effects, as otherwise the
+    // multiplication would have been folded.
+    writeExpression(operand);
+    if (options_.vm_extensions) {
+      vm_writer_->writeDrop();
+    } else {
+      vm_writer_->writePop(Segment::TEMP, multiply_scratch_temp);
+    }
+    vm_writer_->writePush(Segment::CONSTANT, 0);
+    return;
+  }
+  int top_bit = 15;
+  while (((bits >> top_bit) & 1) == 0) {
+    top_bit--;
+  }
+
+  // The product is built from the top bit of the factor down: at each bit
+  // the product so far is doubled, and the operand added if the bit is set.
+  // So the operand is needed more than once, and anything other than a
+  // variable is evaluated once and kept in a temp.
+  Segment operand_segment = operand->segment;
+  int operand_offset = operand->offset;
+  writeExpression(operand);
+  if (operand->type != ExpressionType::VARIABLE) {
+    operand_segment = Segment::TEMP;
+    operand_offset = multiply_operand_temp;
+    if (top_bit > 0) {
+      vm_writer_->writePop(operand_segment, operand_offset);
+      vm_writer_->writePush(operand_segment, operand_offset);
+    }
+  }
+
+  for (int bit = top_bit - 1; bit >= 0; bit--) {
+    if (bit == top_bit - 1) {
+      // The product so far is the operand, so it can be pushed again.
+      vm_writer_->writePush(operand_segment, operand_offset);
+    } else if (options_.vm_extensions) {
+      vm_writer_->writeDup();
+    } else {
+      vm_writer_->writePop(Segment::TEMP, multiply_scratch_temp);
+      vm_writer_->writePush(Segment::TEMP, multiply_scratch_temp);
+      vm_writer_->writePush(Segment::TEMP, multiply_scratch_temp);
+    }
+    vm_writer_->writeArithmetic(OpCommand::ADD);
+    if (((bits >> bit) & 1) != 0) {
+      vm_writer_->writePush(operand_segment, operand_offset);
+      vm_writer_->writeArithmetic(OpCommand::ADD);
+    }
+  }
+  if (is_negative) {
+    vm_writer_->writeArithmetic(OpCommand::NEG);
+  }
+}
+
+const SymbolData& CompilationEngine::getVarData(int var_id) {
+  const SymbolData& var_data = scope_list_.getVarData(var_id);
   if (var_data.segment == Segment::UNKNOWN) {
-    throw UndeclaredVariable(var_name);
+    throw UndeclaredVariable(string_table_.getString(var_id));
   }
   return var_data;
 }
 
 void CompilationEngine::expectKeyword(Keyword::Type k) {
-  if ((tokenizer_->getTokenType() != TokenType::KEYWORD) ||
-      (tokenizer_->getKeyword() != k)) {
-    throw KeywordNotFound(k, tokenizer_->tokenToString());
+  if ((getTokenType() != TokenType::KEYWORD) ||
+      (getKeyword() != k)) {
+    throw KeywordNotFound(k, tokenToString());
   }
   return;
 }
 
 void CompilationEngine::expectType() {
-  if (tokenizer_->getTokenType() == TokenType::IDENTIFIER) {
+  if (getTokenType() == TokenType::IDENTIFIER) {
     return;
   }
-  if ((tokenizer_->getTokenType() == TokenType::KEYWORD) &&
-      (Keyword::IsPrimitiveType(tokenizer_->getKeyword()))) {
+  if ((getTokenType() == TokenType::KEYWORD) &&
+      (Keyword::IsPrimitiveType(getKeyword()))) {
     return;
   }
-  throw InvalidType(tokenizer_->tokenToString());
+  throw InvalidType(tokenToString());
 }
 
 void CompilationEngine::expectFunctionReturnType() {
-  if (tokenizer_->getTokenType() == TokenType::IDENTIFIER) {
+  if (getTokenType() == TokenType::IDENTIFIER) {
     return;
   }
-  if (tokenizer_->getTokenType() == TokenType::KEYWORD) {
-    if ((Keyword::IsPrimitiveType(tokenizer_->getKeyword())) ||
-        (tokenizer_->getKeyword() == Keyword::Type::VOID)) {
+  if (getTokenType() == TokenType::KEYWORD) {
+    if ((Keyword::IsPrimitiveType(getKeyword())) ||
+        (getKeyword() == Keyword::Type::VOID)) {
       return;
     }
   }
-  throw InvalidFunctionReturnType(tokenizer_->tokenToString());
+  throw InvalidFunctionReturnType(tokenToString());
 }
 
 void CompilationEngine::expectIdentifier() {
-  if (tokenizer_->getTokenType() == TokenType::IDENTIFIER) {
+  if (getTokenType() == TokenType::IDENTIFIER) {
     return;
   }
-  throw MissingIdentifier(tokenizer_->tokenToString());
+  throw MissingIdentifier(tokenToString());
 }
 
 bool CompilationEngine::currentTokenIsSimpleTerm() {
-  if ((tokenizer_->getTokenType() == TokenType::STRING_CONST) ||
-      (tokenizer_->getTokenType() == TokenType::INT_CONST) ||
-      ((tokenizer_->getTokenType() == TokenType::KEYWORD) &&
-       (Keyword::IsKeywordConstant(tokenizer_->getKeyword())))) {
+  if ((getTokenType() == TokenType::STRING_CONST) ||
+      (getTokenType() == TokenType::INT_CONST) ||
+      ((getTokenType() == TokenType::KEYWORD) &&
+       (Keyword::IsKeywordConstant(getKeyword())))) {
     return true;
   }
   return false;
 }
 
-void CompilationEngine::compileSimpleTerm() {
-  if (tokenizer_->getTokenType() == TokenType::INT_CONST) {
-    vm_writer_->writePush(Segment::CONSTANT, tokenizer_->getIntVal());
-  } else if (tokenizer_->getTokenType() == TokenType::KEYWORD) {
-    compileKeywordConstant();
-  } else {
-    compileStringConstant();
+Expression* CompilationEngine::parseSimpleTerm() {
+  if (getTokenType() == TokenType::INT_CONST) {
+    Expression* constant = expression_arena_.create(ExpressionType::INT_CONST);
+    constant->value = tokens_.getIntVal(token_idx_);
+    return constant;
   }
+  if (getTokenType() == TokenType::KEYWORD) {
+    return parseKeywordConstant();
+  }
+  Expression* string_const =
+    expression_arena_.create(ExpressionType::STRING_CONST);
+  string_const->value = getTokenId();
+  return string_const;
 }
 
 Keyword::Type CompilationEngine::getSubroutineDecKeyword() {
-  if (tokenizer_->getTokenType() == TokenType::KEYWORD) {
-    Keyword::Type keyword = tokenizer_->getKeyword();
+  if (getTokenType() == TokenType::KEYWORD) {
+    Keyword::Type keyword = getKeyword();
     if ((keyword == Keyword::Type::FUNCTION) ||
         (keyword == Keyword::Type::METHOD) ||
         (keyword == Keyword::Type::CONSTRUCTOR)) {
       return keyword;
     }
   }
-  throw InvalidSubroutineDecKeyword(tokenizer_->tokenToString());
+  throw InvalidSubroutineDecKeyword(tokenToString());
 }
 
 bool CompilationEngine::currentTokenIsBinaryOp() {
-  if ((tokenizer_->getTokenType() == TokenType::SYMBOL) &&
-      ((IsSimpleBinaryOp(tokenizer_->getSymbol())) ||
-       (IsMathOp(tokenizer_->getSymbol())))) {
+  if ((getTokenType() == TokenType::SYMBOL) &&
+      ((IsSimpleBinaryOp(getSymbol())) ||
+       (IsMathOp(getSymbol())))) {
     return true;
   }
   return false;
@@ -750,33 +1805,33 @@ bool CompilationEngine::currentTokenIsBinaryOp() {
 
 std::string CompilationEngine::constructFunctionNameFromCurrToken() {
   std::stringstream ss;
-  ss << curr_class_ << '.' << tokenizer_->tokenToString();
+  ss << curr_class_ << '.' << tokenToString();
   return ss.str();
 }
 
 void CompilationEngine::handleVariableDefinition(
-  std::string var_type, Segment var_segment) {
-  std::string var_name = getVarName();
-  scope_list_->define(var_name, var_type, var_segment);
+  int var_type, Segment var_segment) {
+  int var_name = getVarName();
+  scope_list_.define(var_name, var_type, var_segment);
 }
 
-std::string CompilationEngine::getType() {
+int CompilationEngine::getType() {
   expectType();
-  std::string var_type = tokenizer_->tokenToString();
-  tokenizer_->nextToken();
+  int var_type = getTokenId();
+  nextToken();
   return var_type;
 }
 
-std::string CompilationEngine::getVarName() {
+int CompilationEngine::getVarName() {
   expectIdentifier();
-  std::string var_name = tokenizer_->tokenToString();
-  tokenizer_->nextToken();
+  int var_name = getTokenId();
+  nextToken();
   return var_name;
 }
 
 void CompilationEngine::handleStatementEnd(const std::string compile_tag) {
   if (!currentTokenIsExpectedSymbol(';')) {
-    throw ExpectedStatementEnd(tokenizer_->tokenToString(), compile_tag);
+    throw ExpectedStatementEnd(tokenToString(), compile_tag);
   }
   return;
 }
@@ -785,9 +1840,9 @@ void CompilationEngine::handleOpeningParenthesis(
   char parenthesis, const std::string compile_tag) {
   if (!currentTokenIsExpectedSymbol(parenthesis)) {
     throw ExpectedOpeningParenthesis(
-      tokenizer_->tokenToString(), std::string(1, parenthesis), compile_tag);
+      tokenToString(), std::string(1, parenthesis), compile_tag);
   }
-  tokenizer_->nextToken();
+  nextToken();
   return;
 }
 
@@ -795,34 +1850,16 @@ void CompilationEngine::handleClosingParenthesis(
   char parenthesis, const std::string compile_tag) {
   if (!currentTokenIsExpectedSymbol(parenthesis)) {
     throw ExpectedClosingParenthesis(
-      tokenizer_->tokenToString(), std::string(1, parenthesis), compile_tag);
+      tokenToString(), std::string(1, parenthesis), compile_tag);
   }
-  tokenizer_->nextToken();
+  nextToken();
   return;
 }
 
-void CompilationEngine::handleSymbolDataForSubroutine(
-  std::stringstream* function_name, int* n_args, std::string identifier_name) {
-  // Check the symbol table to see if the identifier is the name of a variable.
-  SymbolData var_data = scope_list_->getVarData(identifier_name);
-  if (var_data.segment == Segment::UNKNOWN) {
-    // We have a class name, so stream the class name and the `.`
-    (*function_name) << identifier_name << '.';
-  } else {
-    // We have the form `varName.subroutineName(...)` so the `varName` is
-    // the first argument to the subroutine.
-    vm_writer_->writePush(var_data.segment, /*idx=*/var_data.offset);
-    (*n_args)++;
-
-    // The type of the variable is the class name, so stream this.
-    (*function_name) << var_data.symbol_type << '.';
-  }
-}
-
 bool CompilationEngine::currentTokenIsClassVarKeyword() {
-  if (tokenizer_->getTokenType() == TokenType::KEYWORD) {
-    if ((tokenizer_->getKeyword() == Keyword::Type::STATIC) ||
-        (tokenizer_->getKeyword() == Keyword::Type::FIELD)) {
+  if (getTokenType() == TokenType::KEYWORD) {
+    if ((getKeyword() == Keyword::Type::STATIC) ||
+        (getKeyword() == Keyword::Type::FIELD)) {
       return true;
     }
   }
@@ -830,22 +1867,28 @@ bool CompilationEngine::currentTokenIsClassVarKeyword() {
 }
 
 bool CompilationEngine::currentTokenIsExpectedSymbol(char expected_symbol) {
-  return ((tokenizer_->getTokenType() == TokenType::SYMBOL) &&
-          (tokenizer_->getSymbol() == expected_symbol));
+  return ((getTokenType() == TokenType::SYMBOL) &&
+          (getSymbol() == expected_symbol));
+}
+
+bool CompilationEngine::nextTokenIsExpectedSymbol(char expected_symbol) {
+  return (token_idx_ + 1 < tokens_.size()) &&
+    (tokens_.getType(token_idx_ + 1) == TokenType::SYMBOL) &&
+    (tokens_.getSymbol(token_idx_ + 1) == expected_symbol);
 }
 
 bool CompilationEngine::currentTokenIsExpectedKeyword(Keyword::Type k) {
-  return ((tokenizer_->getTokenType() == TokenType::KEYWORD) &&
-          (tokenizer_->getKeyword() == k));
+  return ((getTokenType() == TokenType::KEYWORD) &&
+          (getKeyword() == k));
 }
 
 bool CompilationEngine::currentTokenIsStatementKeyword() {
-  if (tokenizer_->getTokenType() == TokenType::KEYWORD) {
-    if ((tokenizer_->getKeyword() == Keyword::Type::LET) ||
-        (tokenizer_->getKeyword() == Keyword::Type::IF) ||
-        (tokenizer_->getKeyword() == Keyword::Type::WHILE) ||
-        (tokenizer_->getKeyword() == Keyword::Type::DO) ||
-        (tokenizer_->getKeyword() == Keyword::Type::RETURN)) {
+  if (getTokenType() == TokenType::KEYWORD) {
+    if ((getKeyword() == Keyword::Type::LET) ||
+        (getKeyword() == Keyword::Type::IF) ||
+        (getKeyword() == Keyword::Type::WHILE) ||
+        (getKeyword() == Keyword::Type::DO) ||
+        (getKeyword() == Keyword::Type::RETURN)) {
       return true;
     }
   }
@@ -857,3 +1900,23 @@ std::string CompilationEngine::constructOutputLabel(std::string label) {
   output_label << label << (label_count_ - 1);
   return output_label.str();
 }
+
+void CompilationEngine::nextToken() {
+  // The buffer ends with an UNKNOWN token, which is never advanced past.
+  if (token_idx_ + 1 < tokens_.size()) {
+    token_idx_++;
+  }
+}
+
+std::string CompilationEngine::tokenToString() {
+  switch (getTokenType()) {
+    case TokenType::SYMBOL:
+      return SymbolToString(getSymbol());
+    case TokenType::INT_CONST:
+      return std::to_string(tokens_.getIntVal(token_idx_));
+    case TokenType::UNKNOWN:
+      return "";
+    default:
+      return string_table_.getString(getTokenId());
+  }
+}
@@ -92,6 +92,14 @@ InvalidFunctionReturnType::InvalidFunctionReturnType(std::string received_token)
                        received_token + ".")
 {}
 
+WrongArgumentCount::WrongArgumentCount(
+  std::string function_name, int expected_count, int received_count)
+  : std::runtime_error(function_name + " expects " +
+                       std::to_string(expected_count) + " arguments, counting "
+                       "the object of a method, but is called with " +
+                       std::to_string(received_count) + ".")
+{}
+
 KeywordNotFound::KeywordNotFound(Keyword::Type expected_keyword,
                                  std::string received_token)
   : std::runtime_error("Expected to receive keyword " +
@@ -0,0 +1,235 @@
+#include "expression.h"
+
+#include <cstdint>
+
+#include "symbol.h"
+
+Expression* ExpressionArena::create(ExpressionType type) {
+  if (n_used_ == expressions_.size()) {
+    expressions_.emplace_back();
+  }
+  Expression* expression = &expressions_[n_used_];
+  n_used_++;
+  expression->type = type;
+  expression->value = 0;
+  expression->segment = Segment::UNKNOWN;
+  expression->offset = 0;
+  expression->function_name.clear();
+  expression->operands.clear();
+  return expression;
+}
+
+bool HasSideEffects(const Expression* expression) {
+  if ((expression->type == ExpressionType::CALL) ||
+      (expression->type == ExpressionType::STRING_CONST)) {
+    return true;
+  }
+  for (const Expression* operand : expression->operands) {
+    if (HasSideEffects(operand)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool IsBooleanExpression(const Expression* expression) {
+  switch (expression->type) {
+    case ExpressionType::INT_CONST:
+      return (expression->value == 0) || (expression->value == -1);
+    case ExpressionType::UNARY_OP:
+      return (expression->value == '~') &&
+        IsBooleanExpression(expression->operands[0]);
+    case ExpressionType::BINARY_OP:
+      if ((expression->value == '&') || (expression->value == '|')) {
+        return IsBooleanExpression(expression->operands[0]) &&
+          IsBooleanExpression(expression->operands[1]);
+      }
+      return IsComparisonOp(expression->value);
+    default:
+      return false;
+  }
+}
+
+// wraps `value` to the 16 bit word the Hack platform would compute.
+static int toWord(int value) {
+  return static_cast<int16_t>(static_cast<uint16_t>(value));
+}
+
+// turns `expression` into the constant `value`.
+static Expression* makeConstant(Expression* expression, int value) {
+  expression->type = ExpressionType::INT_CONST;
+  expression->value = toWord(value);
+  expression->operands.clear();
+  return expression;
+}
+
+// turns `expression` into the negation of `operand`.
+static Expression* makeNegation(Expression* expression, Expression* operand) {
+  expression->type = ExpressionType::UNARY_OP;
+  expression->value = '-';
+  expression->operands.assign(1, operand);
+  return expression;
+}
+
+// Computes `x op y` into `result` as the VM code would. Returns false if the
+// operation cannot be done at compile time.
+static bool evaluateBinaryOp(char op, int x, int y, int* result) {
+  switch (op) {
+    case '+':
+      *result = x + y;
+      return true;
+    case '-':
+      *result = x - y;
+      return true;
+    case '*':
+      *result = x * y;
+      return true;
+    case '/':
+      // Math.divide never returns when dividing by 0, and cannot take the
+      // absolute value of -32768.
+      if ((y == 0) || (x == -32768) || (y == -32768)) {
+        return false;
+      }
+      *result = x / y;
+      return true;
+    case '&':
+      *result = x & y;
+      return true;
+    case '|':
+      *result = x | y;
+      return true;
+    case '<':
+      // the VM compares the sign of the wrapped difference.
+      *result = (toWord(x - y) < 0) ? -1 : 0;
+      return true;
+    case '>':
+      *result = (toWord(x - y) > 0) ? -1 : 0;
+      return true;
+    case '=':
+      *result = (x == y) ? -1 : 0;
+      return true;
+    default:
+      return false;
+  }
+}
+
+static Expression* foldUnaryOp(Expression* expression) {
+  Expression* operand = FoldExpression(expression->operands[0]);
+  expression->operands[0] = operand;
+  char op = static_cast<char>(expression->value);
+  if (operand->type == ExpressionType::INT_CONST) {
+    return makeConstant(
+      expression, (op == '-') ? -operand->value : ~operand->value);
+  }
+  // `--x` and `~~x` are both `x`.
+  if ((operand->type == ExpressionType::UNARY_OP) &&
+      (operand->value == op)) {
+    return operand->operands[0];
+  }
+  return expression;
+}
+
+static Expression* foldBinaryOp(Expression* expression) {
+  Expression* left = FoldExpression(expression->operands[0]);
+  Expression* right = FoldExpression(expression->operands[1]);
+  expression->operands[0] = left;
+  expression->operands[1] = right;
+  char op = static_cast<char>(expression->value);
+
+  bool left_is_const = (left->type == ExpressionType::INT_CONST);
+  bool right_is_const = (right->type == ExpressionType::INT_CONST);
+  int result;
+  if (left_is_const && right_is_const &&
+      evaluateBinaryOp(op, left->value, right->value, &result)) {
+    return makeConstant(expression, result);
+  }
+
+  // Jack evaluates from left to right, so `x + 1 + 2` is `(x + 1) + 2`, which
+  // becomes `x + 3`.
+  if (((op == '+') || (op == '-')) && right_is_const &&
+      (left->type == ExpressionType::BINARY_OP) &&
+      ((left->value == '+') || (left->value == '-')) &&
+      (left->operands[1]->type == ExpressionType::INT_CONST)) {
+    int inner = left->operands[1]->value;
+    int sum = ((left->value == '+') ? inner : -inner) +
+      ((op == '+') ? right->value : -right->value);
+    left = left->operands[0];
+    expression->operands[0] = left;
+    expression->value = '+';
+    op = '+';
+    makeConstant(right, sum);
+  }
+
+  // adding or subtracting a negative constant is the same as subtracting or
+  // adding its absolute value, which is cheaper to push.
+  if (((op == '+') || (op == '-')) && right_is_const &&
+      (right->value < 0) && (right->value != -32768)) {
+    op = (op == '+') ? '-' : '+';
+    expression->value = op;
+    right->value = -right->value;
+  }
+
+  if (right_is_const) {
+    if ((right->value == 0) && ((op == '+') || (op == '-') || (op == '|'))) {
+      return left;
+    }
+    if ((right->value == 1) && ((op == '*') || (op == '/'))) {
+      return left;
+    }
+    if ((right->value == -1) && (op == '&')) {
+      return left;
+    }
+    if ((right->value == -1) && ((op == '*') || (op == '/'))) {
+      return makeNegation(expression, left);
+    }
+    if (!HasSideEffects(left)) {
+      if ((right->value == 0) && ((op == '*') || (op == '&'))) {
+        return makeConstant(expression, 0);
+      }
+      if ((right->value == -1) && (op == '|')) {
+        return makeConstant(expression, -1);
+      }
+    }
+  }
+
+  if (left_is_const) {
+    if ((left->value == 0) && ((op == '+') || (op == '|'))) {
+      return right;
+    }
+    if ((left->value == 0) && (op == '-')) {
+      return makeNegation(expression, right);
+    }
+    if ((left->value == 1) && (op == '*')) {
+      return right;
+    }
+    if ((left->value == -1) && (op == '&')) {
+      return right;
+    }
+    if ((left->value == -1) && (op == '*')) {
+      return makeNegation(expression, right);
+    }
+    if (!HasSideEffects(right)) {
+      if ((left->value == 0) && ((op == '*') || (op == '&'))) {
+        return makeConstant(expression, 0);
+      }
+      if ((left->value == -1) && (op == '|')) {
+        return makeConstant(expression, -1);
+      }
+    }
+  }
+  return expression;
+}
+
+Expression* FoldExpression(Expression* expression) {
+  switch (expression->type) {
+    case ExpressionType::UNARY_OP:
+      return foldUnaryOp(expression);
+    case ExpressionType::BINARY_OP:
+      return foldBinaryOp(expression);
+    default:
+      for (size_t i = 0; i < expression->operands.size(); i++) {
+        expression->operands[i] = FoldExpression(expression->operands[i]);
+      }
+      return expression;
+  }
+}
@@ -1,30 +1,67 @@
 #include "keyword.h"
 
-std::unordered_map<std::string, Keyword::Type> const Keyword::keyword_map_ =
-  {
-    {"class", Type::CLASS},
-    {"method", Type::METHOD},
-    {"function", Type::FUNCTION},
-    {"constructor", Type::CONSTRUCTOR},
-    {"int", Type::INT},
-    {"bool", Type::BOOLEAN},
-    {"boolean", Type::BOOLEAN},
-    {"char", Type::CHAR},
-    {"void", Type::VOID},
-    {"var", Type::VAR},
-    {"static", Type::STATIC},
-    {"field", Type::FIELD},
-    {"let", Type::LET},
-    {"do", Type::DO},
-    {"if", Type::IF},
-    {"else", Type::ELSE},
-    {"while", Type::WHILE},
-    {"return", Type::RETURN},
-    {"true", Type::TRUE},
-    {"false", Type::FALSE},
-    {"null", Type::NULL_VAL},
-    {"this", Type::THIS}
-  };
+#include <array>
+#include <iterator>
+
+struct KeywordEntry {
+  std::string_view keyword_str;
+  Keyword::Type keyword;
+};
+
+static constexpr KeywordEntry keyword_entries[] = {
+  {"class", Keyword::Type::CLASS},
+  {"method", Keyword::Type::METHOD},
+  {"function", Keyword::Type::FUNCTION},
+  {"constructor", Keyword::Type::CONSTRUCTOR},
+  {"int", Keyword::Type::INT},
+  {"bool", Keyword::Type::BOOLEAN},
+  {"boolean", Keyword::Type::BOOLEAN},
+  {"char", Keyword::Type::CHAR},
+  {"void", Keyword::Type::VOID},
+  {"var", Keyword::Type::VAR},
+  {"static", Keyword::Type::STATIC},
+  {"field", Keyword::Type::FIELD},
+  {"let", Keyword::Type::LET},
+  {"do", Keyword::Type::DO},
+  {"if", Keyword::Type::IF},
+  {"else", Keyword::Type::ELSE},
+  {"while", Keyword::Type::WHILE},
+  {"return", Keyword::Type::RETURN},
+  {"true", Keyword::Type::TRUE},
+  {"false", Keyword::Type::FALSE},
+  {"null", Keyword::Type::NULL_VAL},
+  {"this", Keyword::Type::THIS}
+};
+
+static constexpr size_t keyword_table_size = 64;
+
+// A hash giving every keyword its own slot of the keyword table, found by
+// searching small multipliers of the first and last characters and length.
+static constexpr size_t hashKeyword(std::string_view token_str) {
+  return (static_cast<unsigned char>(token_str.front()) +
+          (8 * static_cast<unsigned char>(token_str.back())) +
+          (9 * token_str.size())) & (keyword_table_size - 1);
+}
+
+// Maps each hash to the index of its keyword in `keyword_entries`, or -1.
+// Two keywords sharing a slot would throw, which fails the compile.
+static constexpr std::array<int, keyword_table_size> buildKeywordTable() {
+  std::array<int, keyword_table_size> keyword_table = {};
+  for (size_t i = 0; i < keyword_table_size; i++) {
+    keyword_table[i] = -1;
+  }
+  for (size_t i = 0; i < std::size(keyword_entries); i++) {
+    size_t slot = hashKeyword(keyword_entries[i].keyword_str);
+    if (keyword_table[slot] >= 0) {
+      throw "The keyword hash is not perfect.";
+    }
+    keyword_table[slot] = static_cast<int>(i);
+  }
+  return keyword_table;
+}
+
+static constexpr std::array<int, keyword_table_size> keyword_table =
+  buildKeywordTable();
 
 std::string Keyword::KeywordToString(Keyword::Type k) {
   switch (k) {
@@ -75,16 +112,20 @@ std::string Keyword::KeywordToString(Keyword::Type k) {
   }
 }
 
-Keyword::Type Keyword::GetKeywordFromString(const std::string keyword_str) {
-  auto keyword_pair = keyword_map_.find(keyword_str);
-  if (keyword_pair == keyword_map_.end()) {
+Keyword::Type Keyword::GetKeywordFromString(std::string_view keyword_str) {
+  if (keyword_str.empty()) {
+    return Type::UNKNOWN;
+  }
+  int entry_idx = keyword_table[hashKeyword(keyword_str)];
+  if (entry_idx < 0 ||
+      keyword_entries[entry_idx].keyword_str != keyword_str) {
     return Type::UNKNOWN;
   }
-  return keyword_pair->second;
+  return keyword_entries[entry_idx].keyword;
 }
 
-bool Keyword::IsKeyword(const std::string token_str) {
-  return (keyword_map_.find(token_str) != keyword_map_.end());
+bool Keyword::IsKeyword(std::string_view token_str) {
+  return GetKeywordFromString(token_str) != Type::UNKNOWN;
 }
 
 bool Keyword::IsPrimitiveType(const Keyword::Type k) {
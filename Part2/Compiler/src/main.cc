@@ -1,18 +1,94 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
 #include <filesystem>
+#include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "compilation_engine.h"
+#include "compiler_options.h"
+#include "program_index.h"
 #include "tokenizer.h"
 #include "token_type.h"
 #include "util.h"
 
 namespace fs = std::filesystem;
 
+// Compiles `jack_files` on `n_workers` threads, each with its own
+// `CompilationEngine`, as the classes are compiled independently. The
+// engines share `program_index`, which they only read. A file that fails to
+// compile has its error message stored at its index in `errors`, so that
+// errors can be reported in the same order however the files were
+// scheduled.
+void compileFiles(const std::vector<std::string>& jack_files,
+                  CompilerOptions options,
+                  const ProgramIndex* program_index,
+                  int n_workers,
+                  std::vector<std::string>* errors) {
+  errors->assign(jack_files.size(), "");
+  std::atomic<size_t> next_file_idx(0);
+  auto compile_next_files = [&]() {
+    CompilationEngine compilation_engine(options, program_index);
+    size_t file_idx;
+    while ((file_idx = next_file_idx++) < jack_files.size()) {
+      try {
+        compilation_engine.compile(jack_files[file_idx]);
+      } catch (const std::exception& e) {
+        (*errors)[file_idx] = e.what();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < n_workers; i++) {
+    workers.emplace_back(compile_next_files);
+  }
+  // the calling thread is a worker too.
+  compile_next_files();
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+// Usage:
+//   JackCompiler <file.jack | directory> [--vm-ext] [--string-pool]
+//                [--static-arrays] [--whole-program] [--jobs=<n>]
+// With `--vm-ext`, the compiler emits the extended VM operations, which the
+// VMTranslator in this repository understands. With `--string-pool`, each
+// string constant is built once per program instead of on every use. With
+// `--static-arrays`, small local arrays that never leave their subroutine
+// reuse one block instead of being allocated on every call. With
+// `--whole-program`, every class is indexed before any is compiled, so that
+// the arguments of every call are checked against its declaration and calls
+// of trivial getters and setters of any class are inlined; combined with
+// `--vm-ext`, void subroutines also stop returning a value. The files of a
+// directory are compiled on `n` threads, by default one per core.
 int main(int argc, char** argv) {
-  if (argc > 1) {
-    std::string file_path = ((std::string)argv[1]);
+  std::string file_path = "";
+  CompilerOptions options;
+  int n_jobs =
+    std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  for (int i = 1; i < argc; i++) {
+    std::string arg = ((std::string)argv[i]);
+    if (arg.compare("--vm-ext") == 0) {
+      options.vm_extensions = true;
+    } else if (arg.compare("--string-pool") == 0) {
+      options.string_pool = true;
+    } else if (arg.compare("--static-arrays") == 0) {
+      options.static_arrays = true;
+    } else if (arg.compare("--whole-program") == 0) {
+      options.whole_program = true;
+    } else if (arg.compare(0, 7, "--jobs=") == 0) {
+      n_jobs = std::max(1, std::atoi(arg.substr(7).c_str()));
+    } else {
+      file_path = arg;
+    }
+  }
 
+  if (!file_path.empty()) {
     std::vector<std::string> jack_files;
     std::string ext = ".jack";
     if (endsInExtension(file_path, ext)) {
@@ -28,9 +104,36 @@ int main(int argc, char** argv) {
       }
     }
 
-    CompilationEngine compilation_engine;
+    // The directory is walked in no particular order, so the files are
+    // sorted to keep the error report deterministic.
+    std::sort(jack_files.begin(), jack_files.end());
+
+    ProgramIndex program_index;
+    if (options.whole_program) {
+      for (size_t i = 0; i < jack_files.size(); i++) {
+        try {
+          program_index.addFile(jack_files[i]);
+        } catch (const std::exception&) {
+          // the error is reported when the file is compiled.
+        }
+      }
+    }
+
+    std::vector<std::string> errors;
+    int n_workers = std::min(n_jobs, static_cast<int>(jack_files.size()));
+    compileFiles(jack_files, options,
+                 options.whole_program ? &program_index : nullptr, n_workers,
+                 &errors);
+
+    bool compiled_all = true;
     for (size_t i = 0; i < jack_files.size(); i++) {
-      compilation_engine.compile(jack_files[i]);
+      if (!errors[i].empty()) {
+        std::cerr << jack_files[i] << ": " << errors[i] << "\n";
+        compiled_all = false;
+      }
+    }
+    if (!compiled_all) {
+      return 1;
     }
   }
   return 0;
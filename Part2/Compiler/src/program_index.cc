@@ -0,0 +1,173 @@
+#include "program_index.h"
+
+#include <algorithm>
+
+#include "tokenizer.h"
+
+// Determines if the token at `idx` of `tokens` is an identifier.
+static bool isIdentifier(const TokenBuffer& tokens, size_t idx) {
+  return (idx < tokens.size()) &&
+    (tokens.getType(idx) == TokenType::IDENTIFIER);
+}
+
+// Returns the position of `name_id` in `name_ids`, or -1 if it is not there.
+static int findName(const std::vector<int>& name_ids, int name_id) {
+  auto itr = std::find(name_ids.begin(), name_ids.end(), name_id);
+  return (itr == name_ids.end()) ? -1 : itr - name_ids.begin();
+}
+
+// Finds whether the method with `parameter_ids`, whose body is the
+// `n_body_tokens` tokens of `tokens` from `body_idx`, is a getter or a setter
+// of one of `field_ids`.
+static void findInlineKind(const TokenBuffer& tokens,
+                           size_t body_idx,
+                           size_t n_body_tokens,
+                           const std::vector<int>& field_ids,
+                           const std::vector<int>& parameter_ids,
+                           SubroutineInfo* info) {
+  // `{ return fieldName; }`
+  if (parameter_ids.empty() && (n_body_tokens == 5) &&
+      tokens.isKeyword(body_idx + 1, Keyword::Type::RETURN) &&
+      isIdentifier(tokens, body_idx + 2) &&
+      tokens.isSymbol(body_idx + 3, ';')) {
+    info->field_idx = findName(field_ids, tokens.getId(body_idx + 2));
+    if (info->field_idx >= 0) {
+      info->inline_kind = InlineKind::GETTER;
+    }
+    return;
+  }
+
+  // `{ let fieldName = parameter; return; }`
+  if ((parameter_ids.size() == 1) && (n_body_tokens == 9) &&
+      tokens.isKeyword(body_idx + 1, Keyword::Type::LET) &&
+      isIdentifier(tokens, body_idx + 2) &&
+      (tokens.getId(body_idx + 2) != parameter_ids[0]) &&
+      tokens.isSymbol(body_idx + 3, '=') &&
+      isIdentifier(tokens, body_idx + 4) &&
+      (tokens.getId(body_idx + 4) == parameter_ids[0]) &&
+      tokens.isSymbol(body_idx + 5, ';') &&
+      tokens.isKeyword(body_idx + 6, Keyword::Type::RETURN) &&
+      tokens.isSymbol(body_idx + 7, ';')) {
+    info->field_idx = findName(field_ids, tokens.getId(body_idx + 2));
+    if (info->field_idx >= 0) {
+      info->inline_kind = InlineKind::SETTER;
+    }
+  }
+}
+
+void ProgramIndex::addFile(const std::string& jack_file) {
+  StringTable string_table;
+  TokenBuffer tokens;
+  {
+    Tokenizer tokenizer(jack_file);
+    tokens.lex(&tokenizer, &string_table);
+  }
+
+  size_t idx = 0;
+  while (tokens.isKeyword(idx, Keyword::Type::CLASS) &&
+         addClass(tokens, string_table, &idx)) {}
+}
+
+const SubroutineInfo* ProgramIndex::findSubroutine(
+  const std::string& function_name) const {
+  auto itr = subroutines_.find(function_name);
+  return (itr == subroutines_.end()) ? nullptr : &itr->second;
+}
+
+bool ProgramIndex::addClass(
+  const TokenBuffer& tokens, const StringTable& string_table, size_t* idx) {
+  // skip `class`.
+  size_t i = *idx + 1;
+  if (!isIdentifier(tokens, i) || !tokens.isSymbol(i + 1, '{')) {
+    return false;
+  }
+  std::string class_name = string_table.getString(tokens.getId(i));
+  i += 2;
+
+  // the names of the fields, in the order of their offsets.
+  std::vector<int> field_ids;
+  while (tokens.isKeyword(i, Keyword::Type::STATIC) ||
+         tokens.isKeyword(i, Keyword::Type::FIELD)) {
+    bool is_field = tokens.isKeyword(i, Keyword::Type::FIELD);
+    // skip the keyword and the type.
+    i += 2;
+    while (isIdentifier(tokens, i)) {
+      if (is_field) {
+        field_ids.push_back(tokens.getId(i));
+      }
+      i++;
+      if (!tokens.isSymbol(i, ',')) {
+        break;
+      }
+      i++;
+    }
+    if (!tokens.isSymbol(i, ';')) {
+      return false;
+    }
+    i++;
+  }
+
+  while (tokens.isKeyword(i, Keyword::Type::CONSTRUCTOR) ||
+         tokens.isKeyword(i, Keyword::Type::FUNCTION) ||
+         tokens.isKeyword(i, Keyword::Type::METHOD)) {
+    SubroutineInfo info;
+    info.kind = tokens.getKeyword(i);
+    info.returns_void = tokens.isKeyword(i + 1, Keyword::Type::VOID);
+    info.inline_kind = InlineKind::NONE;
+    info.field_idx = -1;
+
+    // skip the keyword and the return type.
+    i += 2;
+    if (!isIdentifier(tokens, i) || !tokens.isSymbol(i + 1, '(')) {
+      return false;
+    }
+    std::string function_name =
+      class_name + "." + string_table.getString(tokens.getId(i));
+    i += 2;
+
+    // each parameter is a type followed by its name.
+    std::vector<int> parameter_ids;
+    while (!tokens.isSymbol(i, ')')) {
+      if (!isIdentifier(tokens, i + 1)) {
+        return false;
+      }
+      parameter_ids.push_back(tokens.getId(i + 1));
+      i += 2;
+      if (tokens.isSymbol(i, ',')) {
+        i++;
+      }
+    }
+    i++;
+    info.n_parameters = parameter_ids.size();
+
+    // the body runs to the `}` matching its `{`.
+    if (!tokens.isSymbol(i, '{')) {
+      return false;
+    }
+    size_t body_idx = i;
+    int depth = 0;
+    do {
+      if (tokens.getType(i) == TokenType::UNKNOWN) {
+        return false;
+      }
+      if (tokens.isSymbol(i, '{')) {
+        depth++;
+      } else if (tokens.isSymbol(i, '}')) {
+        depth--;
+      }
+      i++;
+    } while (depth > 0);
+
+    if (info.kind == Keyword::Type::METHOD) {
+      findInlineKind(tokens, body_idx, i - body_idx, field_ids, parameter_ids,
+                     &info);
+    }
+    subroutines_[function_name] = info;
+  }
+
+  if (!tokens.isSymbol(i, '}')) {
+    return false;
+  }
+  *idx = i + 1;
+  return true;
+}
@@ -1,72 +1,85 @@
 #include "scope_list.h"
 
-#include <memory>
-
 #include "exceptions.h"
 
-ScopeList::ScopeList()
-  : class_scope_(std::make_unique<ClassTable>()), subroutine_scope_(nullptr)
+// returned for variables that are not declared in any scope.
+static const SymbolData unknown_symbol = {-1, -1, Segment::UNKNOWN, -1};
+
+ScopeList::ScopeList(const StringTable* string_table)
+  : string_table_(string_table), in_subroutine_(false)
 {}
 
+void ScopeList::startClass() {
+  class_scope_.clear();
+  subroutine_scope_.clear();
+  in_subroutine_ = false;
+}
+
 void ScopeList::startSubroutine() {
-  subroutine_scope_ = std::make_unique<SubroutineTable>();
+  subroutine_scope_.clear();
+  in_subroutine_ = true;
 }
 
-void ScopeList::define(
-  std::string var_name, std::string var_type, Segment var_segment) {
+void ScopeList::define(int var_id, int type_id, Segment var_segment) {
+  const std::string& var_name = string_table_->getString(var_id);
+  bool is_new = false;
   switch (var_segment) {
     case Segment::ARGUMENT:
-      // if it is null, we are at the class level.
-      if (subroutine_scope_ == nullptr) {
+      // if it is not in use, we are at the class level.
+      if (!in_subroutine_) {
         throw InvalidArgumentVarDeclaration(var_name);
       }
-      subroutine_scope_->addArgumentVar(var_name, var_type);
+      is_new = subroutine_scope_.addSymbol(var_id, type_id, var_segment);
       break;
     case Segment::LOCAL:
-      // if it is null, we are at the class level.
-      if (subroutine_scope_ == nullptr) {
+      // if it is not in use, we are at the class level.
+      if (!in_subroutine_) {
         throw InvalidLocalVarDeclaration(var_name);
       }
-      subroutine_scope_->addLocalVar(var_name, var_type);
+      is_new = subroutine_scope_.addSymbol(var_id, type_id, var_segment);
       break;
     case Segment::THIS:
-      // if it is not null, we are inside a subroutine.
-      if (subroutine_scope_ != nullptr) {
+      // if it is in use, we are inside a subroutine.
+      if (in_subroutine_) {
         throw InvalidFieldVarDeclaration(var_name);
       }
-      class_scope_->addFieldVar(var_name, var_type);
+      is_new = class_scope_.addSymbol(var_id, type_id, var_segment);
       break;
     case Segment::STATIC:
-      // if it is not null, we are inside a subroutine.
-      if (subroutine_scope_ != nullptr) {
+      // if it is in use, we are inside a subroutine.
+      if (in_subroutine_) {
         throw InvalidStaticVarDeclaration(var_name);
       }
-      class_scope_->addStaticVar(var_name, var_type);
+      is_new = class_scope_.addSymbol(var_id, type_id, var_segment);
       break;
     default:
       throw InvalidDeclarationStatement(var_name);
   }
+  if (!is_new) {
+    throw RedefinitionOfSymbol(var_name);
+  }
 }
 
 int ScopeList::varCount(Segment segment) {
   if ((segment == Segment::ARGUMENT) || (segment == Segment::LOCAL)) {
-    if (subroutine_scope_ == nullptr) {
+    if (!in_subroutine_) {
       throw InvalidScope();
     }
-    return subroutine_scope_->getSegmentCount(segment);
+    return subroutine_scope_.getSegmentCount(segment);
   }
   if ((segment == Segment::THIS) || (segment == Segment::STATIC)) {
-    return class_scope_->getSegmentCount(segment);
+    return class_scope_.getSegmentCount(segment);
   }
   throw InvalidSegmentType();
 }
 
-SymbolData ScopeList::getVarData(std::string var_name) {
-  if (subroutine_scope_ != nullptr) {
-    SymbolData var_data = subroutine_scope_->getSymbolData(var_name);
-    if (var_data.segment != Segment::UNKNOWN) {
-      return var_data;
+const SymbolData& ScopeList::getVarData(int var_id) {
+  if (in_subroutine_) {
+    const SymbolData* var_data = subroutine_scope_.findSymbol(var_id);
+    if (var_data != nullptr) {
+      return *var_data;
     }
   }
-  return class_scope_->getSymbolData(var_name);
+  const SymbolData* var_data = class_scope_.findSymbol(var_id);
+  return (var_data == nullptr) ? unknown_symbol : *var_data;
 }
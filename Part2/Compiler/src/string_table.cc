@@ -0,0 +1,17 @@
+#include "string_table.h"
+
+int StringTable::intern(std::string_view str) {
+  auto itr = ids_.find(str);
+  if (itr != ids_.end()) {
+    return itr->second;
+  }
+  int id = static_cast<int>(strings_.size());
+  strings_.emplace_back(str);
+  ids_.emplace(strings_.back(), id);
+  return id;
+}
+
+void StringTable::clear() {
+  ids_.clear();
+  strings_.clear();
+}
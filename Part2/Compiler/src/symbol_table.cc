@@ -1,58 +1,38 @@
-#include "exceptions.h"
 #include "symbol_table.h"
 
-int SymbolTable::getSegmentCount(Segment segment) {
-  auto itr = segment_counts_.find(segment);
-  if (itr == segment_counts_.end()) {
-    return 0;
-  }
-  return itr->second;
-}
+#include <algorithm>
 
-SymbolData SymbolTable::getSymbolData(std::string var_name) {
-  auto itr = symbol_map_.find(var_name);
-  if (itr == symbol_map_.end()) {
-    return {"", Segment::UNKNOWN, -1};
-  }
-  return itr->second;
-}
+// the capacity reserved up front, enough for almost every Jack scope.
+static const size_t initial_capacity = 32;
 
-void SymbolTable::addSymbol(
-  std::string symbol_name, std::string symbol_type, Segment symbol_segment) {
-  // check for redefinition of symbol.
-  if (symbol_map_.find(symbol_name) != symbol_map_.end()) {
-    throw RedefinitionOfSymbol(symbol_name);
-  }
-
-  // otherwise, add it to the symbol table.
-  symbol_map_[symbol_name] = {
-    symbol_type, symbol_segment, segment_counts_[symbol_segment]};
-  segment_counts_[symbol_segment]++;
+SymbolTable::SymbolTable() {
+  symbols_.reserve(initial_capacity);
+  clear();
 }
 
-ClassTable::ClassTable() : SymbolTable() {
-  segment_counts_ = {{Segment::THIS, 0},
-                     {Segment::STATIC, 0}};
+void SymbolTable::clear() {
+  symbols_.clear();
+  std::fill(std::begin(segment_counts_), std::end(segment_counts_), 0);
 }
 
-void ClassTable::addFieldVar(std::string var_name, std::string var_type) {
-  addSymbol(var_name, var_type, Segment::THIS);
-}
-
-void ClassTable::addStaticVar(std::string var_name, std::string var_type) {
-  addSymbol(var_name, var_type, Segment::STATIC);
-}
-
-SubroutineTable::SubroutineTable() : SymbolTable() {
-  segment_counts_ = {{Segment::ARGUMENT, 0},
-                     {Segment::LOCAL, 0}};
+const SymbolData* SymbolTable::findSymbol(int name_id) const {
+  for (const SymbolData& symbol : symbols_) {
+    if (symbol.name_id == name_id) {
+      return &symbol;
+    }
+  }
+  return nullptr;
 }
 
-void SubroutineTable::addArgumentVar(
-  std::string var_name, std::string var_type) {
-  addSymbol(var_name, var_type, Segment::ARGUMENT);
-}
+bool SymbolTable::addSymbol(int name_id, int type_id, Segment segment) {
+  // check for redefinition of symbol.
+  if (findSymbol(name_id) != nullptr) {
+    return false;
+  }
 
-void SubroutineTable::addLocalVar(std::string var_name, std::string var_type) {
-  addSymbol(var_name, var_type, Segment::LOCAL);
+  // otherwise, add it to the symbol table.
+  int* segment_count = &segment_counts_[static_cast<int>(segment)];
+  symbols_.push_back({name_id, type_id, segment, *segment_count});
+  (*segment_count)++;
+  return true;
 }
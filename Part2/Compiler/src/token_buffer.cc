@@ -0,0 +1,31 @@
+#include "token_buffer.h"
+
+void TokenBuffer::lex(Tokenizer* tokenizer, StringTable* string_table) {
+  types_.clear();
+  ids_.clear();
+  values_.clear();
+  offsets_.clear();
+  while (tokenizer->nextToken()) {
+    TokenType token_type = tokenizer->getTokenType();
+    int id = -1;
+    int value = 0;
+    if (token_type == TokenType::SYMBOL) {
+      value = tokenizer->getSymbol();
+    } else if (token_type == TokenType::INT_CONST) {
+      value = tokenizer->getIntVal();
+    } else {
+      id = string_table->intern(tokenizer->getTokenView());
+      if (token_type == TokenType::KEYWORD) {
+        value = static_cast<int>(tokenizer->getKeyword());
+      }
+    }
+    types_.push_back(token_type);
+    ids_.push_back(id);
+    values_.push_back(value);
+    offsets_.push_back(tokenizer->getTokenOffset());
+  }
+  types_.push_back(TokenType::UNKNOWN);
+  ids_.push_back(-1);
+  values_.push_back(0);
+  offsets_.push_back(tokenizer->getTokenOffset());
+}
@@ -1,101 +1,168 @@
 #include "tokenizer.h"
 
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "exceptions.h"
 #include "symbol.h"
-#include "util.h"
 
-Tokenizer::Tokenizer(std::string jack_file) : token_type_(TokenType::UNKNOWN) {
-  jack_stream_.open(jack_file);
+// The classes a character may belong to, as bit flags.
+static constexpr uint8_t space_class = 1;
+static constexpr uint8_t digit_class = 2;
+static constexpr uint8_t identifier_class = 4;
+static constexpr uint8_t symbol_class = 8;
+static constexpr uint8_t token_start_class = 16;
+
+// The symbols of the Jack language, as in `IsSymbol`.
+static constexpr std::string_view jack_symbols = "{}()[].,;+-*/&|<>=~";
+
+static constexpr std::array<uint8_t, 256> buildCharClasses() {
+  std::array<uint8_t, 256> char_classes = {};
+  for (int c = 0; c < 256; c++) {
+    uint8_t char_class = 0;
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+      char_class |= space_class;
+    }
+    if (c >= '0' && c <= '9') {
+      char_class |= digit_class | identifier_class | token_start_class;
+    }
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+      char_class |= identifier_class | token_start_class;
+    }
+    if (c == '"') {
+      char_class |= token_start_class;
+    }
+    char_classes[c] = char_class;
+  }
+  for (size_t i = 0; i < jack_symbols.size(); i++) {
+    char_classes[static_cast<unsigned char>(jack_symbols[i])] |=
+      symbol_class | token_start_class;
+  }
+  return char_classes;
+}
+
+static constexpr std::array<uint8_t, 256> char_classes = buildCharClasses();
+
+static bool isInClass(char c, uint8_t char_class) {
+  return (char_classes[static_cast<unsigned char>(c)] & char_class) != 0;
+}
+
+// The largest integer constant kept exactly. Larger constants are invalid in
+// Jack, and saturating keeps them from overflowing.
+static const int max_int_val = 0x7fffffff / 10;
+
+Tokenizer::Tokenizer(std::string jack_file)
+  : jack_data_(""),
+    jack_size_(0),
+    pos_(0),
+    mapped_data_(nullptr),
+    token_type_(TokenType::UNKNOWN),
+    token_offset_(0),
+    keyword_(Keyword::Type::UNKNOWN),
+    int_val_(0) {
+  // A file that cannot be opened, or an empty file, has no tokens.
+  int fd = open(jack_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    void* mapped_data = mmap(nullptr, file_stat.st_size, PROT_READ,
+                             MAP_PRIVATE, fd, 0);
+    if (mapped_data != MAP_FAILED) {
+      mapped_data_ = mapped_data;
+      jack_data_ = static_cast<const char*>(mapped_data);
+      jack_size_ = file_stat.st_size;
+    }
+  }
+  close(fd);
+}
+
+Tokenizer::~Tokenizer() {
+  if (mapped_data_ != nullptr) {
+    munmap(mapped_data_, jack_size_);
+  }
 }
 
 bool Tokenizer::hasMoreTokens() {
-  while (!jack_stream_.eof()) {
-    char next_char = jack_stream_.peek();
-    if (startsComment(next_char)) {
-      removeComment(next_char);
-    } else if (isTokenBeginningChar(next_char)) {
+  while (pos_ < jack_size_) {
+    char next_char = jack_data_[pos_];
+    if (isInClass(next_char, space_class)) {
+      pos_++;
+    } else if (startsComment()) {
+      removeComment();
+    } else if (isInClass(next_char, token_start_class)) {
       return true;
-    } else if (isSpaceChar(next_char)) {
-      char curr_char;
-      jack_stream_.get(curr_char);
+    } else {
+      throw InvalidIdentifier(std::string(1, next_char));
     }
   }
   return false;
 }
 
 void Tokenizer::advance() {
-  token_stream_.clear();
-  token_stream_.str(std::string());
-  char next_char = jack_stream_.peek();
+  size_t token_start = pos_;
+  token_offset_ = token_start;
+  char next_char = jack_data_[pos_];
   // We are dealing with a symbol.
-  if (IsSymbol(next_char)) {
+  if (isInClass(next_char, symbol_class)) {
     token_type_ = TokenType::SYMBOL;
-    // It is just a single character, so put it in the stream and return.
-    token_stream_ << getNextCharFromJackStream();
+    pos_++;
+    token_ = std::string_view(jack_data_ + token_start, 1);
     return;
   }
   // we are dealing with an integer.
-  if (isdigit(next_char)) {
+  if (isInClass(next_char, digit_class)) {
     token_type_ = TokenType::INT_CONST;
-    token_stream_ << getNextCharFromJackStream();
-    // keep parsing until we encounter a space or symbol.
-    while(!jack_stream_.eof()) {
-      next_char = jack_stream_.peek();
-      if (isdigit(next_char)) {
-        token_stream_ << getNextCharFromJackStream();
-      } else if (IsSymbol(next_char) || isSpaceChar(next_char)) {
-        break;
-      } else {
-        throw InvalidIdentifier(std::string(1, next_char));
+    int_val_ = 0;
+    while (pos_ < jack_size_ && isInClass(jack_data_[pos_], digit_class)) {
+      if (int_val_ <= max_int_val) {
+        int_val_ = (int_val_ * 10) + (jack_data_[pos_] - '0');
       }
+      pos_++;
     }
+    expectTokenEnd();
+    token_ = std::string_view(jack_data_ + token_start, pos_ - token_start);
     return;
   }
-  // we are dealing with a string.
+  // we are dealing with a string, which runs up to the closing quote.
   if (next_char == '"') {
     token_type_ = TokenType::STRING_CONST;
-    char temp_char;
-    // throw away the opening quote.
-    jack_stream_.get(temp_char);
-    if (!jack_stream_.eof()) {
-      jack_stream_.get(temp_char);
-      // if its not the ending quote then it is part of the string.
-      while ((temp_char != '"') && (!jack_stream_.eof())) {
-        token_stream_ << temp_char;
-        jack_stream_.get(temp_char);
-      }
-      if (temp_char != '"') {
-        throw NonTerminatedString();
-      }
+    const void* closing_quote =
+      memchr(jack_data_ + pos_ + 1, '"', jack_size_ - pos_ - 1);
+    if (closing_quote == nullptr) {
+      pos_ = jack_size_;
+      throw NonTerminatedString();
     }
+    size_t string_end = static_cast<const char*>(closing_quote) - jack_data_;
+    token_ = std::string_view(
+      jack_data_ + token_start + 1, string_end - token_start - 1);
+    pos_ = string_end + 1;
     return;
   }
   // otherwise, we have a keyword or identifier but we need to parse the
   // token to figure out which.
-  token_stream_ << getNextCharFromJackStream();
-  while (!jack_stream_.eof()) {
-    next_char = jack_stream_.peek();
-    if (isIdentifierChar(next_char)) {
-      token_stream_ << getNextCharFromJackStream();
-    } else if (IsSymbol(next_char) || isSpaceChar(next_char)) {
-      break;
-    } else {
-      throw InvalidIdentifier(std::string(1, next_char));
-    }
+  while (pos_ < jack_size_ && isInClass(jack_data_[pos_], identifier_class)) {
+    pos_++;
   }
-  if (Keyword::IsKeyword(token_stream_.str())) {
-    token_type_ = TokenType::KEYWORD;
-  } else {
-    token_type_ = TokenType::IDENTIFIER;
-  }
-  return;
+  expectTokenEnd();
+  token_ = std::string_view(jack_data_ + token_start, pos_ - token_start);
+  keyword_ = Keyword::GetKeywordFromString(token_);
+  token_type_ = (keyword_ == Keyword::Type::UNKNOWN) ? TokenType::IDENTIFIER
+                                                     : TokenType::KEYWORD;
 }
 
 bool Tokenizer::nextToken() {
   if (!hasMoreTokens()) {
     token_type_ = TokenType::UNKNOWN;
-    token_stream_.clear();
-    token_stream_.str(std::string());
+    token_ = std::string_view();
+    token_offset_ = jack_size_;
     return false;
   }
   advance();
@@ -104,75 +171,37 @@ bool Tokenizer::nextToken() {
 
 std::string Tokenizer::tokenToString() {
   if (token_type_ == TokenType::SYMBOL) {
-    const char symbol_char = token_stream_.str().c_str()[0];
-    return SymbolToString(symbol_char);
+    return SymbolToString(token_[0]);
   }
-  return token_stream_.str();
-}
-
-const Keyword::Type Tokenizer::getKeyword() {
-  return Keyword::GetKeywordFromString(token_stream_.str());
+  return std::string(token_);
 }
 
-const char Tokenizer::getSymbol() {
-  return token_stream_.str().c_str()[0];
-}
-
-const std::string Tokenizer::getIdentifier() {
-  return token_stream_.str();
-}
-
-const int Tokenizer::getIntVal() {
-  int int_val;
-  token_stream_ >> int_val;
-  return int_val;
-}
-
-// Note, when we encounter a string we just don't add the '"' to the stream
-// so we can just directly cast it.
-const std::string Tokenizer::getStringVal() {
-  return token_stream_.str();
-}
-
-void Tokenizer::removeComment(char next_char) {
-  char curr_char;
-  if (next_char == '/') {
-    // throw it away, we know we're dealing with a comment.
-    jack_stream_.get(curr_char);
-    next_char = jack_stream_.peek();
-    if (next_char == '/') {
-      // this means we have an inline comment. So just move to next line.
-      std::string line;
-      std::getline(jack_stream_, line);
-    } else if (next_char == '*') {
-      // we are dealing with a block comment. So we keep parsing until we
-      // find '*/'.
-      jack_stream_.get(curr_char);
-      bool found_comment_end = false;
-      while ((!found_comment_end) && (!jack_stream_.eof())) {
-        jack_stream_.get(curr_char);
-        if (curr_char == '*') {
-          jack_stream_.get(curr_char);
-          found_comment_end = (curr_char == '/');
-        }
-      }
-    }
+void Tokenizer::removeComment() {
+  if (jack_data_[pos_ + 1] == '/') {
+    // an inline comment runs to the end of the line.
+    const void* line_end =
+      memchr(jack_data_ + pos_, '\n', jack_size_ - pos_);
+    pos_ = (line_end == nullptr)
+      ? jack_size_
+      : static_cast<const char*>(line_end) - jack_data_ + 1;
+    return;
   }
+  // a block comment runs to the next `*/`, or the end of the file.
+  std::string_view rest(jack_data_ + pos_ + 2, jack_size_ - pos_ - 2);
+  size_t comment_end = rest.find("*/");
+  pos_ = (comment_end == std::string_view::npos)
+    ? jack_size_
+    : pos_ + 2 + comment_end + 2;
 }
 
-char Tokenizer::getNextCharFromJackStream() {
-  return static_cast<char>(jack_stream_.get());
+bool Tokenizer::startsComment() {
+  return (jack_data_[pos_] == '/' && pos_ + 1 < jack_size_ &&
+          (jack_data_[pos_ + 1] == '/' || jack_data_[pos_ + 1] == '*'));
 }
 
-bool Tokenizer::startsComment(char next_char) {
-  if (next_char != '/') {
-    return false;
+void Tokenizer::expectTokenEnd() {
+  if (pos_ < jack_size_ &&
+      !isInClass(jack_data_[pos_], symbol_class | space_class)) {
+    throw InvalidIdentifier(std::string(1, jack_data_[pos_]));
   }
-  jack_stream_.seekg(1, jack_stream_.cur);
-  char second_char = jack_stream_.peek();
-  jack_stream_.seekg(-1, jack_stream_.cur);
-  if ((second_char == '/') || (second_char == '*')) {
-    return true;
-  }
-  return false;
 }
@@ -2,48 +2,257 @@
 
 #include "util.h"
 
-VMWriter::VMWriter(std::string jack_file) {
-  vm_stream_.open(jackFileToOutputFile(jack_file, ".vm"));
+VMWriter::VMWriter(std::string jack_file, bool vm_extensions)
+  : vm_extensions_(vm_extensions),
+    has_function_(false),
+    n_locals_(0),
+    pending_segment_(Segment::UNKNOWN),
+    pending_idx_(0),
+    pending_is_increment_(true),
+    is_suppressed_(false),
+    has_that_address_(false) {
+  vm_file_.open(jackFileToOutputFile(jack_file, ".vm"));
 }
 
 void VMWriter::writePush(Segment memory_segment, int idx) {
-  vm_stream_ << "push " << SegmentToString(memory_segment);
-  vm_stream_ << " " << idx << '\n';
+  if (is_suppressed_) {
+    return;
+  }
+  std::stringstream command;
+  command << "push " << SegmentToString(memory_segment) << " " << idx;
+  if (vm_extensions_) {
+    // `push constant 1` continues a held `push x`.
+    if ((pending_commands_.size() == 1) &&
+        (memory_segment == Segment::CONSTANT) && (idx == 1)) {
+      pending_commands_.push_back(command.str());
+      return;
+    }
+    flushPendingCommands();
+    // Any other variable may start a new sequence.
+    if (memory_segment != Segment::CONSTANT) {
+      pending_segment_ = memory_segment;
+      pending_idx_ = idx;
+      pending_commands_.push_back(command.str());
+      return;
+    }
+  }
+  vm_stream_ << command.str() << '\n';
 }
 
 void VMWriter::writePop(Segment memory_segment, int idx) {
+  if (is_suppressed_) {
+    return;
+  }
+  if (memory_segment == Segment::POINTER) {
+    // THAT is changed, or THIS, which moves the fields.
+    has_that_address_ = false;
+  } else {
+    forgetThatAddressUsing(memory_segment, idx);
+  }
+  if ((pending_commands_.size() == 3) &&
+      (memory_segment == pending_segment_) && (idx == pending_idx_)) {
+    pending_commands_.clear();
+    vm_stream_ << (pending_is_increment_ ? "inc " : "dec ");
+    vm_stream_ << SegmentToString(memory_segment) << " " << idx << '\n';
+    return;
+  }
+  flushPendingCommands();
   vm_stream_ << "pop " << SegmentToString(memory_segment);
   vm_stream_ << " " << idx << '\n';
 }
 
 void VMWriter::writeArithmetic(OpCommand op_command) {
+  if (is_suppressed_) {
+    return;
+  }
+  if ((pending_commands_.size() == 2) &&
+      ((op_command == OpCommand::ADD) || (op_command == OpCommand::SUB))) {
+    pending_is_increment_ = (op_command == OpCommand::ADD);
+    pending_commands_.push_back(OpCommandToString(op_command));
+    return;
+  }
+  flushPendingCommands();
   vm_stream_ << OpCommandToString(op_command) << '\n';
 }
 
 void VMWriter::writeLabel(std::string label) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  has_that_address_ = false;
   vm_stream_ << "label " << label << '\n';
 }
 
 void VMWriter::writeGoTo(std::string label) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
   vm_stream_ << "goto " << label << '\n';
 }
 
 void VMWriter::writeIfGoTo(std::string label) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
   vm_stream_ << "if-goto " << label << '\n';
 }
 
+void VMWriter::writeGoToIndexed(std::string label, int n_labels) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "goto-indexed " << label << " " << n_labels << '\n';
+}
+
 void VMWriter::writeCall(std::string function_name, int n_args) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  // THAT is restored by the return, but the function may change statics and
+  // fields.
+  forgetThatAddressUsing(Segment::STATIC, /*idx=*/-1);
+  forgetThatAddressUsing(Segment::THIS, /*idx=*/-1);
   vm_stream_ << "call " << function_name << " " << n_args << '\n';
 }
 
 void VMWriter::writeFunction(std::string function_name, int n_locals) {
-  vm_stream_ << "function " << function_name << " " << n_locals << '\n';
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  has_that_address_ = false;
+  flushFunction();
+  has_function_ = true;
+  function_name_ = function_name;
+  n_locals_ = n_locals;
 }
 
 void VMWriter::writeReturn() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
   vm_stream_ << "return\n";
 }
 
+void VMWriter::writeCallVoid(std::string function_name, int n_args) {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  // as for `call`, the function may change statics and fields.
+  forgetThatAddressUsing(Segment::STATIC, /*idx=*/-1);
+  forgetThatAddressUsing(Segment::THIS, /*idx=*/-1);
+  vm_stream_ << "call-void " << function_name << " " << n_args << '\n';
+}
+
+void VMWriter::writeReturnVoid() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "return-void\n";
+}
+
+void VMWriter::setLocalCount(int n_locals) {
+  if (is_suppressed_) {
+    return;
+  }
+  n_locals_ = n_locals;
+}
+
+void VMWriter::writeLoad() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "load\n";
+}
+
+void VMWriter::writeStore() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "store\n";
+}
+
+void VMWriter::writeDup() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "dup\n";
+}
+
+void VMWriter::writeDrop() {
+  if (is_suppressed_) {
+    return;
+  }
+  flushPendingCommands();
+  vm_stream_ << "drop\n";
+}
+
+bool VMWriter::thatHolds(const ThatAddress& address) {
+  return has_that_address_ &&
+    (address.base_segment == that_address_.base_segment) &&
+    (address.base_idx == that_address_.base_idx) &&
+    (address.index_segment == that_address_.index_segment) &&
+    ((address.index_segment == Segment::UNKNOWN) ||
+     (address.index_idx == that_address_.index_idx));
+}
+
+void VMWriter::setThatAddress(const ThatAddress& address) {
+  if (is_suppressed_) {
+    return;
+  }
+  has_that_address_ = true;
+  that_address_ = address;
+}
+
+void VMWriter::setSuppressed(bool is_suppressed) {
+  flushPendingCommands();
+  is_suppressed_ = is_suppressed;
+  has_that_address_ = false;
+}
+
 void VMWriter::close() {
-  vm_stream_.close();
+  flushPendingCommands();
+  flushFunction();
+  vm_file_.close();
+}
+
+void VMWriter::flushPendingCommands() {
+  for (size_t i = 0; i < pending_commands_.size(); i++) {
+    vm_stream_ << pending_commands_[i] << '\n';
+  }
+  pending_commands_.clear();
+}
+
+void VMWriter::flushFunction() {
+  if (has_function_) {
+    vm_file_ << "function " << function_name_ << " " << n_locals_ << '\n';
+  }
+  vm_file_ << vm_stream_.str();
+  vm_stream_.str("");
+  has_function_ = false;
+}
+
+void VMWriter::forgetThatAddressUsing(Segment memory_segment, int idx) {
+  if (!has_that_address_) {
+    return;
+  }
+  if ((that_address_.base_segment == memory_segment) &&
+      ((idx < 0) || (that_address_.base_idx == idx))) {
+    has_that_address_ = false;
+  }
+  if ((that_address_.index_segment == memory_segment) &&
+      ((idx < 0) || (that_address_.index_idx == idx))) {
+    has_that_address_ = false;
+  }
 }
@@ -0,0 +1,25 @@
+// File name: Extensions/ExtendedOps/ExtendedOps.tst
+
+// The extended operations are not part of the standard VM language, so
+// there is no VM emulator test for this program.
+
+load ExtendedOps.asm,
+output-file ExtendedOps.out,
+compare-to ExtendedOps.cmp,
+output-list RAM[0]%D1.6.1 RAM[256]%D1.6.1 RAM[257]%D1.6.1 RAM[258]%D1.6.1
+            RAM[259]%D1.6.1 RAM[300]%D1.6.1 RAM[301]%D1.6.1
+            RAM[302]%D1.6.1 RAM[401]%D1.6.1 RAM[6]%D1.6.1
+            RAM[3004]%D1.6.1 RAM[3020]%D1.6.1;
+
+set RAM[0] 256,   // stack pointer
+set RAM[1] 300,   // base address of the local segment
+set RAM[2] 400,   // base address of the argument segment
+set RAM[3] 3000,  // base address of the this segment
+set RAM[4] 3010,  // base address of the that segment
+
+repeat 600 {      // enough cycles to complete the execution
+  ticktock;
+}
+
+// Outputs the stack pointer, the stack and the changed variables
+output;
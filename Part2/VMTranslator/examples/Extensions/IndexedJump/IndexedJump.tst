@@ -0,0 +1,20 @@
+// File name: Extensions/IndexedJump/IndexedJump.tst
+
+// `goto-indexed` is not part of the standard VM language, so there is no VM
+// emulator test for this program.
+
+load IndexedJump.asm,
+output-file IndexedJump.out,
+compare-to IndexedJump.cmp,
+output-list RAM[0]%D1.6.1 RAM[300]%D1.6.1 RAM[301]%D1.6.1 RAM[302]%D1.6.1
+            RAM[303]%D1.6.1 RAM[304]%D1.6.1 RAM[305]%D1.6.1;
+
+set RAM[0] 256,   // stack pointer
+set RAM[1] 300,   // base address of the local segment
+
+repeat 600 {      // enough cycles to complete the execution
+  ticktock;
+}
+
+// Outputs the stack pointer and the result of each dispatch
+output;
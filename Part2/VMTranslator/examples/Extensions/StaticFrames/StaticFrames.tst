@@ -0,0 +1,19 @@
+// File name: Extensions/StaticFrames/StaticFrames.tst
+
+// StaticFrames.asm results from translating this directory with
+// `VMTranslator StaticFrames --static-frames`. The results in RAM[3000]
+// onwards do not depend on the flag, but the stack does: StaticFrames.cmp
+// lists which values move under the standard calling convention.
+
+load StaticFrames.asm,
+output-file StaticFrames.out,
+compare-to StaticFrames.cmp,
+output-list RAM[0]%D1.6.1 RAM[256]%D1.6.1 RAM[3000]%D1.6.1 RAM[3001]%D1.6.1
+            RAM[3002]%D1.6.1 RAM[3003]%D1.6.1;
+
+repeat 10000 {    // enough cycles to complete the execution
+  ticktock;
+}
+
+// Outputs the stack pointer, the top of the stack and the results
+output;
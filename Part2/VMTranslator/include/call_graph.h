@@ -0,0 +1,91 @@
+// The functions of a whole VM program and the calls between them. Used by the
+// whole program translation modes to find facts about a function that depend
+// on every function it may call.
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+
+class CallGraph {
+public:
+  CallGraph() {}
+  CallGraph(const CallGraph&) = delete;
+  CallGraph &operator=(const CallGraph&) = delete;
+  CallGraph(CallGraph&&) = delete;
+  CallGraph &operator=(CallGraph&&) = delete;
+  ~CallGraph() {}
+
+  // adds the functions defined by the VM code `vm_code` and the calls they
+  // make. `analyse` must be called once every module has been added.
+  void addModule(Parser* parser, std::string_view vm_code);
+
+  // propagates the facts about each function through its callees.
+  void analyse();
+
+  // determines if `function_name` is defined by one of the modules.
+  bool hasFunction(const std::string& function_name) const {
+    return functions_.find(function_name) != functions_.end();
+  }
+
+  // the names of every function defined by the modules, in no particular
+  // order.
+  std::vector<std::string> getFunctionNames() const;
+
+  // the functions defined by the modules grouped into the sets of functions
+  // that may call each other recursively. Every group comes before the
+  // groups of the functions it calls.
+  std::vector<std::vector<std::string>> getCallOrder() const;
+
+  // the functions called by `function_name` that are defined by the modules.
+  std::vector<std::string> getCallees(const std::string& function_name) const;
+
+  // determines if calling `function_name` may call `function_name` again
+  // before it returns.
+  bool isRecursive(const std::string& function_name) const;
+
+  // determines if `function_name` leaves exactly its return value, or nothing
+  // if it returns with `return-void`, on the stack when it returns, whichever
+  // path it takes through its code.
+  bool hasBalancedStack(const std::string& function_name) const;
+
+  // the number of local variables of `function_name`.
+  int getNVars(const std::string& function_name) const;
+
+  // the number of arguments `function_name` is called with or reads,
+  // whichever is larger.
+  int getNArgs(const std::string& function_name) const;
+
+  // determines if calling `function_name` may change the pointer register
+  // `pointer i`, either in the function itself or in a function it calls
+  // directly or indirectly. Calls to functions outside the program are
+  // assumed to change both pointers.
+  bool mayWritePointer(const std::string& function_name, int i) const;
+
+private:
+  struct FunctionNode {
+    // the functions called, in the order of their first call.
+    std::vector<std::string> callees;
+    // whether `pop pointer i` may run during a call, indexed by `i`.
+    bool writes_pointer[2] = {false, false};
+    bool is_recursive = false;
+    bool balanced_stack = false;
+    int n_vars = 0;
+    int n_args = 0;
+  };
+
+  // groups the functions into sets of mutually recursive functions, ordered
+  // with callers before their callees.
+  void findRecursiveGroups();
+
+  std::unordered_map<std::string, FunctionNode> functions_;
+  // the largest number of arguments passed to each function by a call.
+  std::unordered_map<std::string, int> call_n_args_;
+  std::vector<std::vector<std::string>> call_order_;
+};
+
+#endif  // CALL_GRAPH_H
@@ -1,10 +1,15 @@
 // Generates assembly code from parsed vm commands and writes the output
-// to an assembly file.
+// to an assembly stream.
+//
+// A comparison is held back until the next command is known. If it is
+// followed by an `if-goto`, optionally after a `not`, the three commands are
+// written as a single conditional jump on the comparison, without pushing
+// the boolean and popping it straight back.
 #ifndef CODE_WRITER_H
 #define CODE_WRITER_H
 
 #include <string>
-#include <fstream>
+#include <ostream>
 #include <memory>
 
 #include "operation.h"
@@ -12,7 +17,7 @@
 
 class CodeWriter {
 public:
-  CodeWriter(std::string assembly_file);
+  CodeWriter(std::ostream* assembly_stream);
   CodeWriter(const CodeWriter&) = delete;
   CodeWriter &operator=(const CodeWriter&) = delete;
   CodeWriter(CodeWriter&&) = delete;
@@ -21,6 +26,12 @@ public:
 
   void setFileName(std::string file_name);
 
+  // sets the frame layout of each function, see `Translator::setFrameLayouts`.
+  void setFrameLayouts(
+    const std::unordered_map<std::string, FrameLayout>* frame_layouts) {
+    translator_->setFrameLayouts(frame_layouts);
+  }
+
   void writeCommandComment(std::string command);
 
   void writeInit();
@@ -35,17 +46,46 @@ public:
 
   void writeIf(std::string label_str);
 
+  // writes a `goto-indexed label_str n_labels`.
+  void writeGoToIndexed(std::string label_str, int n_labels);
+
   void writeFunction(std::string function_name, int n_vars);
 
-  void writeReturn();
+  // writes a `return`, or a `return-void` if `returns_value` is false.
+  void writeReturn(bool returns_value);
+
+  // writes a `call`, or a `call-void` if `returns_value` is false.
+  void writeCall(std::string function_name, int n_args, bool returns_value);
+
+  void writeIncDec(Operation command, std::string segment, int val);
 
-  void writeCall(std::string function_name, int n_args);
+  void writeStackOperation(std::string stack_command);
 
-  void close() { assembly_stream_.close(); }
+  void close();
 
 protected:
-  std::ofstream assembly_stream_;
+  // Writes the comparison held back, and the `not` after it if there is
+  // one, followed by the comment of the command after them.
+  void writePendingComparison();
+
+  // Forgets the comparison held back, writing the comment held back after
+  // it.
+  void clearPendingComparison();
+
+  // Writes the comment for the command `command`, if there is one.
+  void writeComment(const std::string& command);
+
+  // the output stream is owned by the caller.
+  std::ostream* assembly_stream_;
   std::unique_ptr<Translator> translator_;
+
+  // The comparison held back, or empty if there is none, and whether a `not`
+  // negates it. The comments of the `not` and of the command after them are
+  // held back with it.
+  std::string pending_comparison_;
+  bool is_pending_negated_;
+  std::string pending_not_comment_;
+  std::string held_comment_;
 };
 
 #endif  // CODE_WRITER_H
@@ -0,0 +1,19 @@
+// Encodes resolved Hack assembly instructions into the 16-bit binary format
+// of a `.hack` file.
+#ifndef HACK_ENCODER_H
+#define HACK_ENCODER_H
+
+#include <string>
+#include <string_view>
+
+// If `symbol` is one of the symbols predefined by the Hack assembler (`SP`,
+// `LCL`, `ARG`, `THIS`, `THAT`, `R0` to `R15`, `SCREEN`, or `KBD`), returns its
+// address. Otherwise, returns -1.
+int GetPredefinedSymbolAddress(std::string_view symbol);
+
+// Encodes `instruction` as a line of 16 `0`/`1` characters, written to
+// `binary`. A instructions must already be resolved to a numeric address.
+// Returns false if the instruction cannot be encoded.
+bool EncodeInstruction(std::string_view instruction, std::string* binary);
+
+#endif  // HACK_ENCODER_H
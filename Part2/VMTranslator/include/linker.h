@@ -0,0 +1,38 @@
+// Combines relocatable objects into a complete Hack program. The program
+// starts with the bootstrap code calling `Sys.init`, followed by the objects
+// in order of their module names. Every label, return address, static
+// variable and function call is resolved to a numeric address, so the output
+// needs no further symbol resolution.
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <string>
+#include <vector>
+
+#include "object_file.h"
+
+class Linker {
+public:
+  Linker() {}
+  Linker(const Linker&) = delete;
+  Linker &operator=(const Linker&) = delete;
+  Linker(Linker&&) = delete;
+  Linker &operator=(Linker&&) = delete;
+  ~Linker() {}
+
+  void addObject(ObjectFile object) { objects_.push_back(std::move(object)); }
+
+  // links the objects added so far, writing the program to `program` as
+  // assembly, or as `.hack` binary if `binary` is true. If `symbol_map` is not
+  // null, the address of each static variable is written to it. Returns false
+  // and sets `error` if the objects cannot be linked.
+  bool link(bool binary,
+            std::string* program,
+            std::string* symbol_map,
+            std::string* error);
+
+private:
+  std::vector<ObjectFile> objects_;
+};
+
+#endif  // LINKER_H
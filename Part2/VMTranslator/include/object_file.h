@@ -0,0 +1,65 @@
+// A relocatable object for a single translated VM file. The code is Hack
+// assembly without labels or comments, in which every A instruction that
+// refers to a label, a return address, a static variable, or a function of
+// another module is left unresolved and described by a relocation. Objects
+// are combined into a program by the `Linker`.
+//
+// An object is stored as text:
+//   vmo 1
+//   module <name> <n_statics>
+//   exports <n>        followed by n lines `<function> <instruction_idx>`
+//   imports <n>        followed by n lines `<function>`
+//   relocations <n>    followed by n lines `<instruction_idx> <kind> <value>`
+//   code <n>           followed by n instructions, one per line
+// where a relocation kind is `L` for an instruction in the same module,
+// `S` for a static slot, or `I` for an index into the imports.
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vm_translator.h"
+
+enum class RelocationKind {
+  LOCAL = 0,
+  STATIC = 1,
+  IMPORT = 2
+};
+
+// The A instruction at `instruction_idx` addresses `value`, interpreted
+// according to `kind`.
+struct Relocation {
+  int instruction_idx;
+  RelocationKind kind;
+  int value;
+};
+
+struct ObjectFile {
+  std::string name;
+  int n_statics;
+  // the functions defined by the module and the index of their first
+  // instruction.
+  std::vector<std::pair<std::string, int>> exports;
+  // the functions of other modules called by the module.
+  std::vector<std::string> imports;
+  std::vector<Relocation> relocations;
+  std::vector<std::string> code;
+};
+
+// Creates the object for the translated `module`.
+void CreateObjectFile(const TranslatedModule& module, ObjectFile* object);
+
+// Translates `source` directly into `object`.
+void TranslateVMObject(const VMSource& source, ObjectFile* object);
+
+void WriteObjectFile(const ObjectFile& object, std::ostream* object_stream);
+
+// Reads an object written by `WriteObjectFile`. Returns false if the stream
+// does not hold a valid object.
+bool ReadObjectFile(std::istream* object_stream, ObjectFile* object);
+
+#endif  // OBJECT_FILE_H
@@ -16,7 +16,25 @@ enum Operation {
   FUNCTION = 6,
   CALL = 7,
   RETURN = 8,
-  UNKNOWN = 9
+  // The extended VM operations. `inc segment i` and `dec segment i` add one
+  // to or subtract one from `segment i` in place. The stack operations are
+  // `load`, replacing the address on top of the stack with the value at that
+  // address, `store`, popping a value and then an address and writing the
+  // value to the address, `dup`, pushing a copy of the top of the stack, and
+  // `drop`, discarding the top of the stack. The extended comparisons `ge`,
+  // `le` and `ne` are arithmetic operations, the negations of `lt`, `gt` and
+  // `eq`. `call-void f n` calls a function returning with `return-void`,
+  // which gives no value, so the call leaves the stack without its arguments
+  // and without a return value. `goto-indexed label n` pops an index `i` and
+  // jumps to the label `label_i` if `i` is from 0 to n - 1, otherwise
+  // continuing with the next command.
+  INC = 9,
+  DEC = 10,
+  STACK = 11,
+  CALL_VOID = 12,
+  RETURN_VOID = 13,
+  GOTO_INDEXED = 14,
+  UNKNOWN = 15
 };
 
 static std::unordered_map<std::string, Operation> const operation_map =
@@ -30,14 +48,26 @@ static std::unordered_map<std::string, Operation> const operation_map =
     {"and", Operation::ARITHMETIC},
     {"or", Operation::ARITHMETIC},
     {"not", Operation::ARITHMETIC},
+    {"ge", Operation::ARITHMETIC},
+    {"le", Operation::ARITHMETIC},
+    {"ne", Operation::ARITHMETIC},
     {"push", Operation::PUSH},
     {"pop", Operation::POP},
     {"label", Operation::LABEL},
     {"goto", Operation::GOTO},
     {"if-goto", Operation::IF},
+    {"goto-indexed", Operation::GOTO_INDEXED},
     {"function", Operation::FUNCTION},
     {"call", Operation::CALL},
-    {"return", Operation::RETURN}
+    {"return", Operation::RETURN},
+    {"call-void", Operation::CALL_VOID},
+    {"return-void", Operation::RETURN_VOID},
+    {"inc", Operation::INC},
+    {"dec", Operation::DEC},
+    {"load", Operation::STACK},
+    {"store", Operation::STACK},
+    {"dup", Operation::STACK},
+    {"drop", Operation::STACK}
   };
 
 static Operation GetOperationFromString(const std::string op_str) {
@@ -49,14 +79,28 @@ static Operation GetOperationFromString(const std::string op_str) {
 }
 
 static bool IsOperationWithNoArguments(const Operation vm_op) {
-  return (vm_op == Operation::RETURN || vm_op == Operation::UNKNOWN);
+  return (vm_op == Operation::RETURN ||
+          vm_op == Operation::RETURN_VOID ||
+          vm_op == Operation::UNKNOWN);
 }
 
 static bool IsOperationWithTwoArguments(const Operation vm_op) {
   return (vm_op == Operation::PUSH ||
           vm_op == Operation::POP ||
           vm_op == Operation::FUNCTION ||
-          vm_op == Operation::CALL);
+          vm_op == Operation::CALL ||
+          vm_op == Operation::CALL_VOID ||
+          vm_op == Operation::GOTO_INDEXED ||
+          vm_op == Operation::INC ||
+          vm_op == Operation::DEC);
+}
+
+// Determines if the arithmetic operation `op_str` compares two values, giving
+// true (-1) or false (0).
+static bool IsComparisonOperation(const std::string op_str) {
+  return (op_str.compare("eq") == 0 || op_str.compare("gt") == 0 ||
+          op_str.compare("lt") == 0 || op_str.compare("ge") == 0 ||
+          op_str.compare("le") == 0 || op_str.compare("ne") == 0);
 }
 
 #endif  // OPERATION_H
@@ -5,8 +5,10 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <istream>
+#include <memory>
 #include <string>
-#include <fstream>
+#include <string_view>
 
 #include "operation.h"
 
@@ -22,7 +24,10 @@ public:
   // opens the file `vm_file` for parsing.
   void openFile(std::string vm_file);
 
-  // closes the vm file that is currently being parsed.
+  // opens the in-memory VM code `vm_code` for parsing.
+  void openBuffer(std::string_view vm_code);
+
+  // closes the vm file or buffer that is currently being parsed.
   void closeFile();
 
   // determines if the parser has more commands
@@ -48,8 +53,8 @@ public:
 
 private:
   void getCurrCommandComponents();
-  // the input file stream
-  std::ifstream vm_stream_;
+  // the input stream, either a file or an in-memory buffer
+  std::unique_ptr<std::istream> vm_stream_;
 
   // identifies the raw text of the current command
   std::string curr_command_;
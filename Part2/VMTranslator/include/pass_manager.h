@@ -0,0 +1,65 @@
+// Runs a pipeline of optimization passes over the modules of a VM program
+// between parsing and translation, optionally timing each pass and keeping
+// the VM code produced by one of them.
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vm_module.h"
+#include "vm_passes.h"
+
+class PassManager {
+public:
+  PassManager() : time_passes_(false) {}
+  PassManager(const PassManager&) = delete;
+  PassManager &operator=(const PassManager&) = delete;
+  PassManager(PassManager&&) = delete;
+  PassManager &operator=(PassManager&&) = delete;
+  ~PassManager() {}
+
+  // selects the passes named in the comma separated list `pass_names`, to be
+  // run in the order given. A pass may be named more than once. Returns false
+  // and sets `error` if a pass does not exist.
+  bool setPipeline(const std::string& pass_names, std::string* error);
+
+  // determines if any pass has been selected.
+  bool hasPasses() const { return !passes_.empty(); }
+
+  // records the wall time and the change in the number of instructions of
+  // each pass that is run.
+  void setTimePasses(bool time_passes) { time_passes_ = time_passes; }
+
+  // keeps the VM code of every module as it is after the pass `pass_name`
+  // runs. Returns false and sets `error` if the pass is not in the pipeline.
+  bool setDumpAfter(const std::string& pass_name, std::string* error);
+
+  // runs the pipeline over `modules`, one pass at a time.
+  void run(std::vector<VMModule>* modules);
+
+  // writes the time and instruction counts recorded for each pass.
+  void writeTimingReport(std::ostream* report_stream) const;
+
+  // the VM code kept after the pass given to `setDumpAfter`, with each
+  // module preceded by a comment naming it. Empty if nothing was kept.
+  const std::string& getDump() const { return dump_; }
+
+private:
+  struct PassTiming {
+    std::string pass_name;
+    double seconds;
+    int n_instructions_before;
+    int n_instructions_after;
+  };
+
+  std::vector<std::unique_ptr<VMPass>> passes_;
+  bool time_passes_;
+  std::vector<PassTiming> timings_;
+  std::string dump_after_;
+  std::string dump_;
+};
+
+#endif  // PASS_MANAGER_H
@@ -0,0 +1,52 @@
+// Assigns fixed RAM addresses to the static variables of each VM file when
+// translating a directory. Files are allocated consecutive blocks starting at
+// the base of the static segment, so the layout only depends on the set of
+// files and the statics they use.
+#ifndef STATIC_ALLOCATOR_H
+#define STATIC_ALLOCATOR_H
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class StaticAllocator {
+public:
+  StaticAllocator();
+  StaticAllocator(const StaticAllocator&) = delete;
+  StaticAllocator &operator=(const StaticAllocator&) = delete;
+  StaticAllocator(StaticAllocator&&) = delete;
+  StaticAllocator &operator=(StaticAllocator&&) = delete;
+  ~StaticAllocator() {}
+
+  // reserves `n_statics` consecutive addresses for the statics of the file
+  // `file_name` and returns the address of `file_name.0`. Returns -1, and
+  // reserves nothing, if the statics would run past the static segment into
+  // the stack.
+  int allocate(std::string file_name, int n_statics);
+
+  // the error reported when the statics of `file_name` could not be
+  // allocated.
+  static std::string getOverflowError(std::string file_name);
+
+  // retrieves the address of `file_name.0`. Returns -1 if no addresses were
+  // allocated for `file_name`.
+  int getBaseAddress(std::string file_name);
+
+  // the first address that has not been allocated to a static variable.
+  int getNextAddress() { return next_address_; }
+
+  // writes the address of every allocated static variable to `map_stream`,
+  // one `File.i address` pair per line.
+  void writeSymbolMap(std::ostream* map_stream);
+
+private:
+  int next_address_;
+  // the base address of each file, in the order the files were allocated.
+  std::vector<std::pair<std::string, int>> allocations_;
+  std::unordered_map<std::string, int> base_addresses_;
+  std::unordered_map<std::string, int> static_counts_;
+};
+
+#endif  // STATIC_ALLOCATOR_H
@@ -0,0 +1,97 @@
+// A long running translation service listening on a Unix domain socket. Each
+// translated module is cached by its name and contents, so modules shared
+// between requests (such as the OS classes) are only translated once.
+//
+// A request is a header line followed by its sources:
+//   translate <program|file> <n_sources>\n
+// where each source is either an in-memory buffer or a file read by the
+// server:
+//   buffer <name> <n_bytes>\n<n_bytes of VM code>
+//   path <vm_file_path>\n
+// where the path runs to the end of its line, so it may hold spaces. A path
+// that cannot be read fails the request. The response is either
+//   ok <n_assembly_bytes> <n_map_bytes>\n<assembly><symbol map>
+// or
+//   error <n_bytes>\n<message>
+// A connection may send any number of requests, which are served in order.
+// Separate connections are served concurrently by a fixed pool of workers.
+// Connections beyond those the workers and their queue can hold wait to be
+// accepted.
+#ifndef TRANSLATION_SERVER_H
+#define TRANSLATION_SERVER_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vm_translator.h"
+
+class TranslationServer {
+public:
+  TranslationServer(std::string socket_path);
+  TranslationServer(const TranslationServer&) = delete;
+  TranslationServer &operator=(const TranslationServer&) = delete;
+  TranslationServer(TranslationServer&&) = delete;
+  TranslationServer &operator=(TranslationServer&&) = delete;
+  ~TranslationServer();
+
+  // listens on the socket and serves connections until the process is killed.
+  // Returns false if the socket could not be opened.
+  bool serve();
+
+private:
+  // takes connections from the queue and serves them, until the process is
+  // killed.
+  void runWorker();
+
+  // serves the connection `connection_fd` until it is closed, then closes
+  // it. A request that fails unexpectedly is answered with an error and ends
+  // the connection.
+  void handleConnection(int connection_fd);
+
+  // serves requests from the connection `connection_fd` until it is closed.
+  void serveRequests(int connection_fd);
+
+  // translates `sources` as a program if `is_program` is true, otherwise as a
+  // single file, writing the results to `assembly` and `symbol_map`. Returns
+  // false and sets `error` if the program cannot be linked.
+  bool translate(const std::vector<VMSource>& sources, bool is_program,
+                 std::string* assembly, std::string* symbol_map,
+                 std::string* error);
+
+  // retrieves the translation of `source` from the cache, translating and
+  // caching it if it has not been seen before.
+  std::shared_ptr<const TranslatedModule> getTranslatedModule(
+    const VMSource& source);
+
+  std::string socket_path_;
+  int listen_fd_;
+
+  // guards `pending_fds_`, the accepted connections not yet taken by a
+  // worker. `queue_changed_` is signalled whenever one is added or taken.
+  std::mutex queue_mutex_;
+  std::condition_variable queue_changed_;
+  std::deque<int> pending_fds_;
+
+  // guards `module_cache_`, which is shared by all connections.
+  std::mutex cache_mutex_;
+  // maps the name and contents of a VM file to its translation.
+  std::unordered_map<std::string, std::shared_ptr<const TranslatedModule>>
+    module_cache_;
+};
+
+// Sends a translation request for the VM files `vm_paths` to the server
+// listening on `socket_path`. Returns false and sets `error` if the request
+// failed.
+bool RequestTranslation(std::string socket_path,
+                        const std::vector<std::string>& vm_paths,
+                        bool is_program,
+                        std::string* assembly,
+                        std::string* symbol_map,
+                        std::string* error);
+
+#endif  // TRANSLATION_SERVER_H
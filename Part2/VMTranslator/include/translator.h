@@ -5,6 +5,25 @@
 
 #include <string>
 #include <sstream>
+#include <unordered_map>
+
+// How a call to a function saves the state of its caller and where the
+// function keeps its arguments and local variables.
+struct FrameLayout {
+  // the pointer registers saved in the frame, on top of the return address,
+  // LCL and ARG which are always saved on the stack. Leaving out a pointer
+  // the function can never change shrinks both the call and the return.
+  bool saves_this;
+  bool saves_that;
+  // the RAM address of the function's static frame, or -1 if the frame is on
+  // the stack. A static frame holds the return address, the saved pointers,
+  // the arguments and then the local variables at fixed addresses, and is
+  // only used for functions that can never be called again before they
+  // return.
+  int static_frame_address;
+  // the number of argument slots in a static frame.
+  int n_args;
+};
 
 class Translator {
 public:
@@ -15,8 +34,20 @@ public:
   Translator &operator=(Translator&&) = delete;
   ~Translator() {}
 
+  // sets the name of the file being translated. The name prefixes the file's
+  // static variables and its internal labels, so that each file translates
+  // to the same code regardless of the files translated before it.
   void setStaticSegmentName(std::string static_segment) {
     static_segment_ = static_segment;
+    label_idx_ = 0;
+  }
+
+  // sets the frame layout of each function. Functions without a layout, or
+  // every function if `frame_layouts` is null, save both THIS and THAT. The
+  // layouts are owned by the caller.
+  void setFrameLayouts(
+    const std::unordered_map<std::string, FrameLayout>* frame_layouts) {
+    frame_layouts_ = frame_layouts;
   }
 
   // translates the system init operation into assembly code.
@@ -40,16 +71,42 @@ public:
   // translates the VM if-goto operation of the form `if-goto label_str`.
   std::string translateIfGoToOperation(std::string label_str);
 
+  // translates the extended VM operation `goto-indexed label_str n_labels`.
+  // An index in range selects an entry of a table of jumps to the labels,
+  // which follows the code jumping into it. Any other index jumps past the
+  // table.
+  std::string translateGoToIndexedOperation(
+    std::string label_str, int n_labels);
+
+  // translates the VM comparison `operation`, negated by a `not` if
+  // `is_negated`, followed by the VM operation `if-goto label_str`. The
+  // comparison jumps to the label directly, without pushing its result.
+  std::string translateComparisonIfGoToOperation(
+    std::string operation, bool is_negated, std::string label_str);
+
   // translates the VM function operation of the form
   // `function function_name n_vars`.
   std::string translateFunctionOperation(
     std::string function_name, int n_vars);
 
-  // translates the VM return operation of the form `return`.
-  std::string translateReturnOperation();
+  // translates the VM return operation of the form `return`, or the extended
+  // operation `return-void` if `returns_value` is false.
+  std::string translateReturnOperation(bool returns_value);
+
+  // translates the VM call operation of the form `call function_name n_args`,
+  // or the extended operation `call-void function_name n_args` if
+  // `returns_value` is false.
+  std::string translateCallOperation(
+    std::string function_name, int n_args, bool returns_value);
 
-  // translates the VM call operation of the form `call function_name n_args`.
-  std::string translateCallOperation(std::string function_name, int n_args);
+  // translates the extended VM operation `inc segment i` if `is_increment`
+  // is true, otherwise `dec segment i`.
+  std::string translateIncDecOperation(
+    bool is_increment, std::string segment, int i);
+
+  // translates the extended VM stack operation given by `operation`. One of
+  // `load`, `store`, `dup`, or `drop`.
+  std::string translateStackOperation(std::string operation);
 
 private:
   // translates a VM combination command. One of `add`, `sub`, `and`, or `or`.
@@ -58,7 +115,8 @@ private:
   // translates a VM negation command. One of `neg` or `not`.
   void translateNegation(std::string negation_expression);
 
-  // translates a VM comparison command. One of `eq`, `lt`, or `gt`.
+  // translates a VM comparison command. One of `eq`, `lt`, `gt`, `ne`, `ge`,
+  // or `le`.
   void translateComparison(std::string comparison_expression);
 
   // translates the VM instruction `push constant i`.
@@ -77,8 +135,9 @@ private:
   void addOffsetAndPushToStack(int offset);
 
   // translates the VM instruction `pop segment i` where segment is
-  // one of `local`, `argument`, `this`, or `that`.
-  void popSegment(int i);
+  // one of `local`, `argument`, `this`, or `that`, whose base address is held
+  // in the register `segment_name`.
+  void popSegment(std::string segment_name, int i);
 
   // translates the VM instruction `pop temp i`.
   void popTemp(int i);
@@ -86,6 +145,9 @@ private:
   // translates the VM instruction `pop static i`.
   void popStatic(int i);
 
+  // the assembly command addressing the variable `static i`.
+  void atStaticCommand(int i);
+
   // translates the VM instruction `push pointer i`
   void popPointer(int i);
 
@@ -94,6 +156,14 @@ private:
   // stack pointer.
   void addOffsetAndPopFromStack(int offset);
 
+  // sets A to `offset` plus the value of the segment register A points to,
+  // by incrementing A. Only used for small offsets.
+  void addSegmentOffsetChain(int offset);
+
+  // sets A to the address of `segment i`. Returns false if `segment i` has
+  // no address, as for the `constant` segment.
+  bool addressSegmentSlot(std::string segment, int i);
+
   // refreshes the output stream.
   void refreshOutputStream();
 
@@ -126,9 +196,45 @@ private:
   // the assembly command `@label_str`.
   void atLabelCommand(std::string label_str);
 
+  // adds the label string for the current comparison cleanup label.
+  void addCleanupLabelString();
+
   // adds the label string for `label_str`.
   void addLabelString(std::string label_str);
 
+  // adds the label string for `label_str` in the current bulk memory
+  // intrinsic or jump table.
+  void addIntrinsicLabelString(std::string label_str);
+
+  // adds the label `label_str` of the current bulk memory intrinsic or jump
+  // table.
+  void createIntrinsicLabel(std::string label_str);
+
+  // adds the assembly commands to jump to the label `label_str` of the
+  // current bulk memory intrinsic or jump table with `jump_expression`.
+  void jumpToIntrinsicLabel(std::string label_str,
+                            std::string jump_expression);
+
+  // adds the assembly commands setting D to the top of the stack, then
+  // replacing the top of the stack with 0 if `replace_with_zero` is true, and
+  // popping it otherwise.
+  void popOrReplaceWithZero(bool replace_with_zero);
+
+  // adds an unrolled loop in place of `call Memory.fill 3`, setting the `len`
+  // words from `addr` to `value`. The return value 0 is left on the stack if
+  // `returns_value` is true.
+  void inlineMemoryFill(bool returns_value);
+
+  // adds an unrolled loop in place of `call Memory.copy 3`, copying the `len`
+  // words from `src` to `dst`. The blocks may overlap. The return value 0 is
+  // left on the stack if `returns_value` is true.
+  void inlineMemoryCopy(bool returns_value);
+
+  // adds the loops of `Memory.copy` moving the pointers in R13 and R14 up if
+  // `is_upwards` is true, otherwise down, until the `len` words in R15 have
+  // been copied.
+  void addCopyLoops(std::string label_prefix, bool is_upwards);
+
   // adds the return address
   void addReturnAddress();
 
@@ -148,6 +254,22 @@ private:
   // jump to the function `function_name` taking `n_args`.
   void saveCurrStateAndJumpToFunction(std::string function_name, int n_args);
 
+  // adds the assembly commands to move the `n_args` arguments on top of the
+  // stack into the static frame of `function_name` and jump to it, passing
+  // the return address in D.
+  void jumpToStaticFrameFunction(std::string function_name, int n_args);
+
+  // adds the assembly commands to call `function_name` taking `n_args`,
+  // using the frame layout of `function_name`.
+  void callFunction(std::string function_name, int n_args);
+
+  // the address of `segment i` when `segment` is `local` or `argument` and
+  // the current function has a static frame. Otherwise, returns -1.
+  int getStaticFrameAddress(std::string segment, int i);
+
+  // retrieves the frame layout of calls to `function_name`.
+  FrameLayout getFrameLayout(const std::string& function_name);
+
   int label_idx_;
   std::string static_segment_;
   // identifies the name of the current function. An empty string indicates
@@ -156,6 +278,9 @@ private:
   // indicates the number of call commands executed inside the current
   // function.
   int func_calls_;
+  const std::unordered_map<std::string, FrameLayout>* frame_layouts_;
+  // the frame layout of the current function.
+  FrameLayout curr_frame_layout_;
   std::stringstream out_stream_;
 };
 
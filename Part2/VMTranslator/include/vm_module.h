@@ -0,0 +1,37 @@
+// A VM file parsed into a list of commands, the in-memory form of the VM code
+// that the optimization passes rewrite before it is translated.
+#ifndef VM_MODULE_H
+#define VM_MODULE_H
+
+#include <string>
+#include <vector>
+
+#include "operation.h"
+#include "vm_translator.h"
+
+// A single parsed VM command. `arg1` holds the operation itself for the
+// arithmetic and stack operations, and `arg2` is only meaningful for the
+// operations taking two arguments.
+struct VMCommand {
+  Operation command_type;
+  std::string arg1;
+  int arg2;
+};
+
+struct VMModule {
+  std::string name;
+  std::vector<VMCommand> commands;
+};
+
+// Parses the VM code of `source` into `module`.
+void ParseVMModule(const VMSource& source, VMModule* module);
+
+// Writes the commands of `module` as VM code, one per line, appending them to
+// `vm_code`.
+void WriteVMModule(const VMModule& module, std::string* vm_code);
+
+// The number of commands of `module` that are translated to code, which is
+// every command other than a label.
+int CountVMInstructions(const VMModule& module);
+
+#endif  // VM_MODULE_H
@@ -0,0 +1,36 @@
+// The optimization passes over VM code. Each pass rewrites a single module
+// into equivalent VM code that translates to fewer or faster instructions,
+// and passes are chosen and ordered by the `PassManager`.
+#ifndef VM_PASSES_H
+#define VM_PASSES_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vm_module.h"
+
+class VMPass {
+public:
+  VMPass() {}
+  VMPass(const VMPass&) = delete;
+  VMPass &operator=(const VMPass&) = delete;
+  VMPass(VMPass&&) = delete;
+  VMPass &operator=(VMPass&&) = delete;
+  virtual ~VMPass() {}
+
+  // the name the pass is selected by.
+  virtual std::string getName() const = 0;
+
+  // rewrites the commands of `module`.
+  virtual void run(VMModule* module) = 0;
+};
+
+// The names of every pass, in the order they are best run.
+std::vector<std::string> GetVMPassNames();
+
+// Creates the pass named `pass_name`, or returns null if there is no such
+// pass.
+std::unique_ptr<VMPass> CreateVMPass(const std::string& pass_name);
+
+#endif  // VM_PASSES_H
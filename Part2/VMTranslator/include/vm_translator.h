@@ -0,0 +1,71 @@
+// The entry points of the vmtranslator library. Translates VM code held in
+// memory into Hack assembly, without touching the filesystem, so that the
+// translator can be linked into other tools.
+#ifndef VM_TRANSLATOR_H
+#define VM_TRANSLATOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A VM file held in memory. `name` is the file name without the `.vm`
+// extension and is used to name the file's static variables.
+struct VMSource {
+  std::string name;
+  std::string_view code;
+};
+
+// A VM file translated on its own. The assembly code refers to the file's
+// static variables with `@File.i` symbols, so the module does not depend on
+// any other file and can be reused across programs.
+struct TranslatedModule {
+  std::string name;
+  std::string assembly;
+  int n_statics;
+  // the functions defined by the module, in the order they are defined.
+  std::vector<std::string> functions;
+};
+
+// Options for translating a whole program. These rely on seeing every
+// function of the program, so they do not apply to single files or modules.
+struct ProgramOptions {
+  // save THIS and THAT across a call only if the function called, or a
+  // function it calls, may change them with `pop pointer i`.
+  bool lean_frames = false;
+  // give functions that can never be called again before they return fixed
+  // RAM addresses for their return address, arguments and local variables,
+  // in the RAM left over by the static variables.
+  bool static_frames = false;
+};
+
+// Translates the single VM file `source`, appending the assembly code to
+// `assembly`. No bootstrap code is written and static variables are left as
+// `@File.i` symbols for the assembler to allocate.
+void TranslateVMFile(const VMSource& source, std::string* assembly);
+
+// Translates the program made up of `sources`, appending the assembly code to
+// `assembly`. This is equivalent to translating a directory: the bootstrap
+// code is written and static variables are given fixed addresses. If
+// `symbol_map` is not null, the address of each static variable is appended
+// to it. Returns false and sets `error` if the static variables do not fit in
+// the static segment.
+bool TranslateVMProgram(std::vector<VMSource> sources,
+                        const ProgramOptions& options,
+                        std::string* assembly,
+                        std::string* symbol_map,
+                        std::string* error);
+
+// Translates `source` into `module`, independently of any other file.
+void TranslateVMModule(const VMSource& source, TranslatedModule* module);
+
+// Combines the translated `modules`, in the order given, into a program:
+// writes the bootstrap code, gives the static variables fixed addresses and
+// appends the result to `assembly`. If `symbol_map` is not null, the address
+// of each static variable is appended to it. Returns false and sets `error`
+// if the static variables do not fit in the static segment.
+bool LinkVMModules(const std::vector<const TranslatedModule*>& modules,
+                   std::string* assembly,
+                   std::string* symbol_map,
+                   std::string* error);
+
+#endif  // VM_TRANSLATOR_H
@@ -0,0 +1,312 @@
+#include "call_graph.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "vm_module.h"
+
+// Determines if the function made up of `commands` always returns with just
+// its return value, or nothing for `return-void`, on top of the stack it
+// started with. Follows every path
+// through the function, tracking the depth of its stack, and fails if a
+// label can be reached with two different depths, the function pops more
+// than it pushed, or control can run past its last command.
+static bool isStackBalanced(const std::vector<VMCommand>& commands) {
+  std::unordered_map<std::string, size_t> label_idxs;
+  for (size_t i = 0; i < commands.size(); i++) {
+    if (commands[i].command_type == Operation::LABEL) {
+      label_idxs[commands[i].arg1] = i;
+    }
+  }
+
+  // the stack depth before each command, or -1 if it has not been reached.
+  std::vector<int> depths(commands.size(), -1);
+  std::vector<size_t> unvisited;
+  auto reach = [&](size_t idx, int depth) {
+    if (idx >= commands.size() || depth < 0) {
+      return false;
+    }
+    if (depths[idx] < 0) {
+      depths[idx] = depth;
+      unvisited.push_back(idx);
+    }
+    return depths[idx] == depth;
+  };
+  auto jump = [&](const std::string& label, int depth) {
+    auto itr = label_idxs.find(label);
+    return itr != label_idxs.end() && reach(itr->second, depth);
+  };
+
+  if (!reach(0, 0)) {
+    return false;
+  }
+  while (!unvisited.empty()) {
+    size_t idx = unvisited.back();
+    unvisited.pop_back();
+    const VMCommand& command = commands[idx];
+    int depth = depths[idx];
+    bool valid = true;
+    if (command.command_type == Operation::PUSH) {
+      valid = reach(idx + 1, depth + 1);
+    } else if (command.command_type == Operation::POP) {
+      valid = reach(idx + 1, depth - 1);
+    } else if (command.command_type == Operation::ARITHMETIC) {
+      bool is_unary = (command.arg1.compare("neg") == 0 ||
+                       command.arg1.compare("not") == 0);
+      valid = (depth >= (is_unary ? 1 : 2)) &&
+        reach(idx + 1, is_unary ? depth : depth - 1);
+    } else if (command.command_type == Operation::LABEL) {
+      valid = reach(idx + 1, depth);
+    } else if (command.command_type == Operation::GOTO) {
+      valid = jump(command.arg1, depth);
+    } else if (command.command_type == Operation::IF) {
+      valid = jump(command.arg1, depth - 1) && reach(idx + 1, depth - 1);
+    } else if (command.command_type == Operation::GOTO_INDEXED) {
+      valid = reach(idx + 1, depth - 1);
+      for (int i = 0; valid && (i < command.arg2); i++) {
+        valid = jump(command.arg1 + "_" + std::to_string(i), depth - 1);
+      }
+    } else if (command.command_type == Operation::CALL) {
+      valid = (depth >= command.arg2) &&
+        reach(idx + 1, depth - command.arg2 + 1);
+    } else if (command.command_type == Operation::CALL_VOID) {
+      valid = (depth >= command.arg2) && reach(idx + 1, depth - command.arg2);
+    } else if (command.command_type == Operation::RETURN) {
+      valid = (depth == 1);
+    } else if (command.command_type == Operation::RETURN_VOID) {
+      valid = (depth == 0);
+    } else if (command.command_type == Operation::INC ||
+               command.command_type == Operation::DEC) {
+      valid = reach(idx + 1, depth);
+    } else if (command.command_type == Operation::STACK) {
+      // `load` replaces the top of the stack, `store` pops two values, `dup`
+      // pushes one and `drop` pops one.
+      int n_popped = 1;
+      int n_pushed = 1;
+      if (command.arg1.compare("store") == 0) {
+        n_popped = 2;
+        n_pushed = 0;
+      } else if (command.arg1.compare("dup") == 0) {
+        n_pushed = 2;
+      } else if (command.arg1.compare("drop") == 0) {
+        n_pushed = 0;
+      }
+      valid = (depth >= n_popped) &&
+        reach(idx + 1, depth - n_popped + n_pushed);
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CallGraph::addModule(Parser* parser, std::string_view vm_code) {
+  // commands outside of any function cannot be called, so they are skipped.
+  FunctionNode* curr_function = nullptr;
+  std::vector<VMCommand> function_commands;
+  parser->openBuffer(vm_code);
+  while (parser->hasMoreCommands()) {
+    parser->advance();
+    Operation command_type = parser->commandType();
+    if (command_type == Operation::FUNCTION) {
+      if (curr_function != nullptr) {
+        curr_function->balanced_stack = isStackBalanced(function_commands);
+      }
+      function_commands.clear();
+      curr_function = &functions_[parser->getArg1()];
+      curr_function->n_vars = parser->getArg2();
+      continue;
+    }
+    if (curr_function == nullptr) {
+      continue;
+    }
+
+    function_commands.push_back(
+      {command_type, parser->getArg1(), parser->getArg2()});
+    if (command_type == Operation::CALL ||
+        command_type == Operation::CALL_VOID) {
+      std::vector<std::string>* callees = &curr_function->callees;
+      if (std::find(callees->begin(), callees->end(), parser->getArg1()) ==
+          callees->end()) {
+        callees->push_back(parser->getArg1());
+      }
+      int* n_args = &call_n_args_[parser->getArg1()];
+      *n_args = std::max(*n_args, parser->getArg2());
+    } else if (command_type == Operation::PUSH ||
+               command_type == Operation::POP ||
+               command_type == Operation::INC ||
+               command_type == Operation::DEC) {
+      std::string segment = parser->getArg1();
+      if (segment.compare("argument") == 0) {
+        curr_function->n_args =
+          std::max(curr_function->n_args, parser->getArg2() + 1);
+      } else if (segment.compare("local") == 0) {
+        curr_function->n_vars =
+          std::max(curr_function->n_vars, parser->getArg2() + 1);
+      } else if (command_type != Operation::PUSH &&
+                 segment.compare("pointer") == 0) {
+        curr_function->writes_pointer[parser->getArg2() == 0 ? 0 : 1] = true;
+      }
+    }
+  }
+  if (curr_function != nullptr) {
+    curr_function->balanced_stack = isStackBalanced(function_commands);
+  }
+  parser->closeFile();
+}
+
+void CallGraph::analyse() {
+  for (auto& function_pair : functions_) {
+    auto itr = call_n_args_.find(function_pair.first);
+    if (itr != call_n_args_.end()) {
+      function_pair.second.n_args =
+        std::max(function_pair.second.n_args, itr->second);
+    }
+  }
+
+  // A function writes a pointer if any of its callees does. Every pass that
+  // changes a function marks another pointer as written, so this terminates.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto& function_pair : functions_) {
+      FunctionNode* function = &function_pair.second;
+      for (size_t i = 0; i < function->callees.size(); i++) {
+        for (int pointer = 0; pointer < 2; pointer++) {
+          if (!function->writes_pointer[pointer] &&
+              mayWritePointer(function->callees[i], pointer)) {
+            function->writes_pointer[pointer] = true;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  findRecursiveGroups();
+}
+
+std::vector<std::string> CallGraph::getFunctionNames() const {
+  std::vector<std::string> function_names;
+  for (auto const& function_pair : functions_) {
+    function_names.push_back(function_pair.first);
+  }
+  // sorted so that anything derived from the order is deterministic.
+  std::sort(function_names.begin(), function_names.end());
+  return function_names;
+}
+
+std::vector<std::vector<std::string>> CallGraph::getCallOrder() const {
+  return call_order_;
+}
+
+std::vector<std::string> CallGraph::getCallees(
+  const std::string& function_name) const {
+  std::vector<std::string> callees;
+  auto itr = functions_.find(function_name);
+  if (itr == functions_.end()) {
+    return callees;
+  }
+  for (size_t i = 0; i < itr->second.callees.size(); i++) {
+    if (hasFunction(itr->second.callees[i])) {
+      callees.push_back(itr->second.callees[i]);
+    }
+  }
+  return callees;
+}
+
+bool CallGraph::isRecursive(const std::string& function_name) const {
+  auto itr = functions_.find(function_name);
+  return itr != functions_.end() && itr->second.is_recursive;
+}
+
+bool CallGraph::hasBalancedStack(const std::string& function_name) const {
+  auto itr = functions_.find(function_name);
+  return itr != functions_.end() && itr->second.balanced_stack;
+}
+
+int CallGraph::getNVars(const std::string& function_name) const {
+  auto itr = functions_.find(function_name);
+  return (itr == functions_.end()) ? 0 : itr->second.n_vars;
+}
+
+int CallGraph::getNArgs(const std::string& function_name) const {
+  auto itr = functions_.find(function_name);
+  return (itr == functions_.end()) ? 0 : itr->second.n_args;
+}
+
+bool CallGraph::mayWritePointer(const std::string& function_name,
+                                int i) const {
+  auto itr = functions_.find(function_name);
+  if (itr == functions_.end()) {
+    return true;
+  }
+  return itr->second.writes_pointer[i == 0 ? 0 : 1];
+}
+
+void CallGraph::findRecursiveGroups() {
+  // Tarjan's algorithm finds the strongly connected components of the call
+  // graph, each after all of the components it calls.
+  std::unordered_map<std::string, int> visit_idxs;
+  std::unordered_map<std::string, int> low_links;
+  std::unordered_map<std::string, bool> on_stack;
+  std::vector<std::string> visit_stack;
+  int next_visit_idx = 0;
+  call_order_.clear();
+
+  std::function<void(const std::string&)> visit =
+    [&](const std::string& function_name) {
+      visit_idxs[function_name] = next_visit_idx;
+      low_links[function_name] = next_visit_idx;
+      next_visit_idx++;
+      visit_stack.push_back(function_name);
+      on_stack[function_name] = true;
+
+      std::vector<std::string> callees = getCallees(function_name);
+      for (size_t i = 0; i < callees.size(); i++) {
+        if (visit_idxs.find(callees[i]) == visit_idxs.end()) {
+          visit(callees[i]);
+          low_links[function_name] =
+            std::min(low_links[function_name], low_links[callees[i]]);
+        } else if (on_stack[callees[i]]) {
+          low_links[function_name] =
+            std::min(low_links[function_name], visit_idxs[callees[i]]);
+        }
+      }
+
+      if (low_links[function_name] != visit_idxs[function_name]) {
+        return;
+      }
+      std::vector<std::string> group;
+      std::string member;
+      do {
+        member = visit_stack.back();
+        visit_stack.pop_back();
+        on_stack[member] = false;
+        group.push_back(member);
+      } while (member != function_name);
+      call_order_.push_back(group);
+    };
+
+  std::vector<std::string> function_names = getFunctionNames();
+  for (size_t i = 0; i < function_names.size(); i++) {
+    if (visit_idxs.find(function_names[i]) == visit_idxs.end()) {
+      visit(function_names[i]);
+    }
+  }
+  // the groups were found callees first.
+  std::reverse(call_order_.begin(), call_order_.end());
+
+  for (size_t i = 0; i < call_order_.size(); i++) {
+    const std::vector<std::string>& group = call_order_[i];
+    std::vector<std::string> callees = getCallees(group[0]);
+    bool calls_itself =
+      std::find(callees.begin(), callees.end(), group[0]) != callees.end();
+    for (size_t j = 0; j < group.size(); j++) {
+      functions_[group[j]].is_recursive = (group.size() > 1) || calls_itself;
+    }
+  }
+}
@@ -1,59 +1,141 @@
 #include "code_writer.h"
 
-CodeWriter::CodeWriter(std::string assembly_file)
-  : translator_(std::make_unique<Translator>())
-{
-  assembly_stream_.open(assembly_file);
-}
+CodeWriter::CodeWriter(std::ostream* assembly_stream)
+  : assembly_stream_(assembly_stream),
+    translator_(std::make_unique<Translator>()),
+    is_pending_negated_(false)
+{}
 
 void CodeWriter::setFileName(std::string file_name) {
   translator_->setStaticSegmentName(file_name);
 }
 
 void CodeWriter::writeCommandComment(std::string command) {
-  assembly_stream_ << "// " << command << "\n";
+  if (!pending_comparison_.empty()) {
+    held_comment_ = command;
+    return;
+  }
+  (*assembly_stream_) << "// " << command << "\n";
 }
 
 void CodeWriter::writeInit() {
-  assembly_stream_ << translator_->translateInitOperation();
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateInitOperation();
 }
 
 void CodeWriter::writePushPop(
   Operation command, std::string segment, int val) {
+  writePendingComparison();
   if (command == Operation::PUSH) {
-    assembly_stream_ << translator_->translatePushOperation(segment, val);
+    (*assembly_stream_) << translator_->translatePushOperation(segment, val);
   } else {
-    assembly_stream_ << translator_->translatePopOperation(segment, val);
+    (*assembly_stream_) << translator_->translatePopOperation(segment, val);
   }
 }
 
 void CodeWriter::writeArithmetic(std::string arithmetic_command) {
-  assembly_stream_ << translator_->translateArithmeticOperation(
+  if (!pending_comparison_.empty() && !is_pending_negated_ &&
+      arithmetic_command.compare("not") == 0) {
+    is_pending_negated_ = true;
+    pending_not_comment_ = held_comment_;
+    held_comment_.clear();
+    return;
+  }
+  writePendingComparison();
+  if (IsComparisonOperation(arithmetic_command)) {
+    pending_comparison_ = arithmetic_command;
+    return;
+  }
+  (*assembly_stream_) << translator_->translateArithmeticOperation(
     arithmetic_command);
 }
 
 void CodeWriter::writeLabel(std::string label_str) {
-  assembly_stream_ << translator_->translateLabelOperation(label_str);
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateLabelOperation(label_str);
 }
 
 void CodeWriter::writeGoTo(std::string label_str) {
-  assembly_stream_ << translator_->translateGoToOperation(label_str);
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateGoToOperation(label_str);
 }
 
 void CodeWriter::writeIf(std::string label_str) {
-  assembly_stream_ << translator_->translateIfGoToOperation(label_str);
+  if (pending_comparison_.empty()) {
+    (*assembly_stream_) << translator_->translateIfGoToOperation(label_str);
+    return;
+  }
+  std::string comparison = pending_comparison_;
+  bool is_negated = is_pending_negated_;
+  clearPendingComparison();
+  (*assembly_stream_) << translator_->translateComparisonIfGoToOperation(
+    comparison, is_negated, label_str);
+}
+
+void CodeWriter::writeGoToIndexed(std::string label_str, int n_labels) {
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateGoToIndexedOperation(
+    label_str, n_labels);
 }
 
 void CodeWriter::writeFunction(std::string function_name, int n_vars) {
-  assembly_stream_ << translator_->translateFunctionOperation(
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateFunctionOperation(
     function_name, n_vars);
 }
 
-void CodeWriter::writeReturn() {
-  assembly_stream_ << translator_->translateReturnOperation();
+void CodeWriter::writeReturn(bool returns_value) {
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateReturnOperation(returns_value);
+}
+
+void CodeWriter::writeCall(
+  std::string function_name, int n_args, bool returns_value) {
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateCallOperation(
+    function_name, n_args, returns_value);
+}
+
+void CodeWriter::writeIncDec(
+  Operation command, std::string segment, int val) {
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateIncDecOperation(
+    command == Operation::INC, segment, val);
 }
 
-void CodeWriter::writeCall(std::string function_name, int n_args) {
-  assembly_stream_ << translator_->translateCallOperation(
-    function_name, n_args);
+void CodeWriter::writeStackOperation(std::string stack_command) {
+  writePendingComparison();
+  (*assembly_stream_) << translator_->translateStackOperation(stack_command);
+}
+
+void CodeWriter::close() {
+  writePendingComparison();
+  assembly_stream_->flush();
+}
+
+void CodeWriter::writePendingComparison() {
+  if (pending_comparison_.empty()) {
+    return;
+  }
+  (*assembly_stream_) << translator_->translateArithmeticOperation(
+    pending_comparison_);
+  if (is_pending_negated_) {
+    writeComment(pending_not_comment_);
+    (*assembly_stream_) << translator_->translateArithmeticOperation("not");
+  }
+  clearPendingComparison();
+}
+
+void CodeWriter::clearPendingComparison() {
+  pending_comparison_.clear();
+  is_pending_negated_ = false;
+  pending_not_comment_.clear();
+  writeComment(held_comment_);
+  held_comment_.clear();
+}
+
+void CodeWriter::writeComment(const std::string& command) {
+  if (!command.empty()) {
+    (*assembly_stream_) << "// " << command << "\n";
+  }
 }
@@ -0,0 +1,107 @@
+#include "hack_encoder.h"
+
+#include <bitset>
+#include <ctype.h>
+#include <unordered_map>
+
+static std::unordered_map<std::string_view, int> const predefined_symbols = {
+  {"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4},
+  {"R0", 0}, {"R1", 1}, {"R2", 2}, {"R3", 3}, {"R4", 4}, {"R5", 5},
+  {"R6", 6}, {"R7", 7}, {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11},
+  {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15},
+  {"SCREEN", 16384}, {"KBD", 24576}
+};
+
+// The `a c1 c2 c3 c4 c5 c6` bits of each computation.
+static std::unordered_map<std::string_view, std::string_view> const comp_bits =
+  {
+    {"0", "0101010"}, {"1", "0111111"}, {"-1", "0111010"},
+    {"D", "0001100"}, {"A", "0110000"}, {"M", "1110000"},
+    {"!D", "0001101"}, {"!A", "0110001"}, {"!M", "1110001"},
+    {"-D", "0001111"}, {"-A", "0110011"}, {"-M", "1110011"},
+    {"D+1", "0011111"}, {"A+1", "0110111"}, {"M+1", "1110111"},
+    {"D-1", "0001110"}, {"A-1", "0110010"}, {"M-1", "1110010"},
+    {"D+A", "0000010"}, {"D+M", "1000010"},
+    {"D-A", "0010011"}, {"D-M", "1010011"},
+    {"A-D", "0000111"}, {"M-D", "1000111"},
+    {"D&A", "0000000"}, {"D&M", "1000000"},
+    {"D|A", "0010101"}, {"D|M", "1010101"}
+  };
+
+static std::unordered_map<std::string_view, std::string_view> const jump_bits =
+  {
+    {"", "000"}, {"JGT", "001"}, {"JEQ", "010"}, {"JGE", "011"},
+    {"JLT", "100"}, {"JNE", "101"}, {"JLE", "110"}, {"JMP", "111"}
+  };
+
+int GetPredefinedSymbolAddress(std::string_view symbol) {
+  auto symbol_pair = predefined_symbols.find(symbol);
+  if (symbol_pair == predefined_symbols.end()) {
+    return -1;
+  }
+  return symbol_pair->second;
+}
+
+bool EncodeInstruction(std::string_view instruction, std::string* binary) {
+  if (instruction.empty()) {
+    return false;
+  }
+
+  if (instruction[0] == '@') {
+    // A instruction: `0` followed by the 15 bit address.
+    if (instruction.size() == 1) {
+      return false;
+    }
+    int address = 0;
+    for (size_t i = 1; i < instruction.size(); i++) {
+      if (!isdigit(instruction[i])) {
+        return false;
+      }
+      address = (address * 10) + (instruction[i] - '0');
+      if (address > 32767) {
+        return false;
+      }
+    }
+    *binary = "0" + std::bitset<15>(address).to_string();
+    return true;
+  }
+
+  // C instruction: `dest=comp;jump` where `dest=` and `;jump` are optional.
+  std::string_view dest = "";
+  std::string_view comp = instruction;
+  std::string_view jump = "";
+  size_t equals_pos = comp.find('=');
+  if (equals_pos != std::string_view::npos) {
+    dest = comp.substr(0, equals_pos);
+    comp = comp.substr(equals_pos + 1);
+  }
+  size_t semicolon_pos = comp.find(';');
+  if (semicolon_pos != std::string_view::npos) {
+    jump = comp.substr(semicolon_pos + 1);
+    comp = comp.substr(0, semicolon_pos);
+  }
+
+  auto comp_pair = comp_bits.find(comp);
+  auto jump_pair = jump_bits.find(jump);
+  if (comp_pair == comp_bits.end() || jump_pair == jump_bits.end()) {
+    return false;
+  }
+  std::string dest_bits = "000";
+  for (char dest_char : dest) {
+    if (dest_char == 'A') {
+      dest_bits[0] = '1';
+    } else if (dest_char == 'D') {
+      dest_bits[1] = '1';
+    } else if (dest_char == 'M') {
+      dest_bits[2] = '1';
+    } else {
+      return false;
+    }
+  }
+
+  *binary = "111";
+  binary->append(comp_pair->second);
+  binary->append(dest_bits);
+  binary->append(jump_pair->second);
+  return true;
+}
@@ -0,0 +1,136 @@
+#include "linker.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+#include "hack_encoder.h"
+#include "static_allocator.h"
+#include "translator.h"
+
+// The number of instructions that fit in the Hack ROM.
+static const size_t rom_size = 32768;
+
+bool Linker::link(bool binary,
+                  std::string* program,
+                  std::string* symbol_map,
+                  std::string* error) {
+  // The bootstrap code is linked like any other module. It imports `Sys.init`
+  // and its return address is a local label.
+  Translator translator;
+  TranslatedModule bootstrap_module = {"", translator.translateInitOperation(),
+                                       0, {}};
+  ObjectFile bootstrap;
+  CreateObjectFile(bootstrap_module, &bootstrap);
+
+  // Link the modules in a fixed order so that the program does not depend on
+  // the order the objects were given in.
+  std::vector<const ObjectFile*> objects;
+  for (size_t i = 0; i < objects_.size(); i++) {
+    objects.push_back(&objects_[i]);
+  }
+  std::sort(objects.begin(), objects.end(),
+            [](const ObjectFile* lhs, const ObjectFile* rhs) {
+              return lhs->name < rhs->name;
+            });
+  objects.insert(objects.begin(), &bootstrap);
+
+  // Lay out the code and statics of each object, and record the address of
+  // each exported function.
+  std::vector<int> code_base_addresses;
+  std::vector<int> static_base_addresses;
+  std::unordered_map<std::string, int> function_addresses;
+  StaticAllocator static_allocator;
+  size_t n_instructions = 0;
+  for (size_t i = 0; i < objects.size(); i++) {
+    const ObjectFile* object = objects[i];
+    if ((i > 0) && (object->name.compare(objects[i - 1]->name) == 0)) {
+      *error = "Module " + object->name + " is linked more than once.";
+      return false;
+    }
+    code_base_addresses.push_back(n_instructions);
+    static_base_addresses.push_back(
+      static_allocator.allocate(object->name, object->n_statics));
+    if (static_base_addresses.back() < 0) {
+      *error = StaticAllocator::getOverflowError(object->name);
+      return false;
+    }
+    for (size_t j = 0; j < object->exports.size(); j++) {
+      const std::string& function_name = object->exports[j].first;
+      if (function_addresses.find(function_name) != function_addresses.end()) {
+        *error = "Function " + function_name + " is defined more than once.";
+        return false;
+      }
+      function_addresses[function_name] =
+        n_instructions + object->exports[j].second;
+    }
+    n_instructions += object->code.size();
+  }
+  if (binary && (n_instructions > rom_size)) {
+    *error = "The program has " + std::to_string(n_instructions) +
+             " instructions, which does not fit in the ROM.";
+    return false;
+  }
+
+  std::ostringstream program_stream;
+  for (size_t i = 0; i < objects.size(); i++) {
+    const ObjectFile* object = objects[i];
+
+    // Resolve the address each relocated instruction refers to.
+    std::vector<int> resolved_addresses(object->code.size(), -1);
+    for (size_t j = 0; j < object->relocations.size(); j++) {
+      const Relocation& relocation = object->relocations[j];
+      int address = relocation.value;
+      if (relocation.kind == RelocationKind::LOCAL) {
+        address += code_base_addresses[i];
+      } else if (relocation.kind == RelocationKind::STATIC) {
+        address += static_base_addresses[i];
+      } else {
+        const std::string& function_name = object->imports[relocation.value];
+        auto function_pair = function_addresses.find(function_name);
+        if (function_pair == function_addresses.end()) {
+          *error = "Undefined function " + function_name + " called from " +
+                   (object->name.empty() ? "the bootstrap code" :
+                    "module " + object->name) + ".";
+          return false;
+        }
+        address = function_pair->second;
+      }
+      resolved_addresses[relocation.instruction_idx] = address;
+    }
+
+    // Exported functions are kept as labels in assembly output, which makes
+    // the program easier to follow and has no effect on the machine code.
+    size_t export_idx = 0;
+    for (size_t j = 0; j < object->code.size(); j++) {
+      std::string instruction = object->code[j];
+      if (resolved_addresses[j] >= 0) {
+        instruction = "@" + std::to_string(resolved_addresses[j]);
+      }
+      if (binary) {
+        std::string encoded;
+        if (!EncodeInstruction(instruction, &encoded)) {
+          *error = "Cannot encode instruction " + instruction + " in module " +
+                   object->name + ".";
+          return false;
+        }
+        program_stream << encoded << "\n";
+        continue;
+      }
+      while ((export_idx < object->exports.size()) &&
+             (object->exports[export_idx].second == static_cast<int>(j))) {
+        program_stream << "(" << object->exports[export_idx].first << ")\n";
+        export_idx++;
+      }
+      program_stream << instruction << "\n";
+    }
+  }
+  program->append(program_stream.str());
+
+  if (symbol_map != nullptr) {
+    std::ostringstream map_stream;
+    static_allocator.writeSymbolMap(&map_stream);
+    symbol_map->append(map_stream.str());
+  }
+  return true;
+}
@@ -2,12 +2,14 @@
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <utility>
 #include <vector>
 
-#include "operation.h"
-#include "parser.h"
-#include "code_writer.h"
+#include "object_file.h"
+#include "pass_manager.h"
+#include "translation_server.h"
+#include "vm_translator.h"
 
 namespace fs = std::filesystem;
 
@@ -22,12 +24,108 @@ std::string constructAssemblyFile(std::string file_path) {
   return ss.str();
 }
 
+std::string constructSymbolMapFile(std::string file_path) {
+  std::stringstream ss;
+  ss << file_path << ".map";
+  return ss.str();
+}
+
+std::string constructDumpFile(std::string file_path, std::string pass_name) {
+  std::stringstream ss;
+  ss << file_path << "." << pass_name << ".vmdump";
+  return ss.str();
+}
+
+std::string readFile(std::string file_path) {
+  std::ifstream file_stream(file_path);
+  std::stringstream ss;
+  ss << file_stream.rdbuf();
+  return ss.str();
+}
 
+std::string constructObjectFile(std::string vm_path) {
+  fs::path object_path = vm_path;
+  object_path.replace_extension(".vmo");
+  return object_path.string();
+}
 
+void writeFile(std::string file_path, const std::string& contents) {
+  std::ofstream file_stream(file_path);
+  file_stream << contents;
+  file_stream.close();
+}
+
+// Usage:
+//   VMTranslator <file.vm | directory> [--server <socket_path>]
+//   VMTranslator <directory> [--lean-frames] [--static-frames]
+//   VMTranslator <file.vm | directory> --passes=<pass,...> [--time-passes]
+//                [--dump-after=<pass>]
+//   VMTranslator <file.vm | directory> --object
+//   VMTranslator --serve <socket_path>
+// With `--server`, the translation is done by the server listening on
+// `socket_path` rather than in this process. With `--object`, each VM file is
+// translated to a relocatable `.vmo` object next to it, to be combined by
+// `vmlink`. Objects that are newer than their VM file are not rebuilt. With
+// `--lean-frames`, calls only save THIS and THAT if the function called may
+// change them. With `--static-frames`, functions that are never recursive
+// keep their arguments and local variables at fixed addresses. Both need the
+// whole program and so a directory. With `--passes`, the named optimization
+// passes rewrite the VM code, in order, before it is translated.
+// `--time-passes` reports the time each pass took and how it changed the
+// number of VM instructions, and `--dump-after` writes the VM code as it is
+// after a pass to `<name>.<pass>.vmdump`.
 int main(int argc, char** argv) {
-  if (argc > 1) {
-    std::string vm_file = ((std::string)argv[1]);
+  std::string vm_file = "";
+  std::string socket_path = "";
+  bool serve = false;
+  bool write_objects = false;
+  ProgramOptions program_options;
+  PassManager pass_manager;
+  bool time_passes = false;
+  std::string dump_after_pass = "";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = ((std::string)argv[i]);
+    if ((arg.compare("--serve") == 0) && (i + 1 < argc)) {
+      serve = true;
+      socket_path = ((std::string)argv[++i]);
+    } else if ((arg.compare("--server") == 0) && (i + 1 < argc)) {
+      socket_path = ((std::string)argv[++i]);
+    } else if (arg.compare("--object") == 0) {
+      write_objects = true;
+    } else if (arg.compare("--lean-frames") == 0) {
+      program_options.lean_frames = true;
+    } else if (arg.compare("--static-frames") == 0) {
+      program_options.static_frames = true;
+    } else if (arg.compare(0, 9, "--passes=") == 0) {
+      std::string error;
+      if (!pass_manager.setPipeline(arg.substr(9), &error)) {
+        std::cerr << error << "\n";
+        return 1;
+      }
+    } else if (arg.compare("--time-passes") == 0) {
+      time_passes = true;
+    } else if (arg.compare(0, 13, "--dump-after=") == 0) {
+      dump_after_pass = arg.substr(13);
+    } else {
+      vm_file = arg;
+    }
+  }
+
+  pass_manager.setTimePasses(time_passes);
+  if (!dump_after_pass.empty()) {
+    std::string error;
+    if (!pass_manager.setDumpAfter(dump_after_pass, &error)) {
+      std::cerr << error << "\n";
+      return 1;
+    }
+  }
+
+  if (serve) {
+    TranslationServer server(socket_path);
+    return server.serve() ? 0 : 1;
+  }
 
+  if (!vm_file.empty()) {
     std::vector<std::pair<std::string, std::string>> vm_name_path_pairs;
     std::string file_path = vm_file;
     bool is_directory = false;
@@ -55,44 +153,97 @@ int main(int argc, char** argv) {
       file_path = ss.str();
     }
 
-    std::string assembly_path = constructAssemblyFile(file_path);
-    CodeWriter code_writer(assembly_path);
-    Parser parser;
+    if ((program_options.lean_frames || program_options.static_frames) &&
+        (!is_directory || write_objects || !socket_path.empty())) {
+      std::cerr << "Warning: --lean-frames and --static-frames only apply "
+                << "when translating a directory in this process, and are "
+                << "ignored.\n";
+    }
+    if (pass_manager.hasPasses() && (write_objects || !socket_path.empty())) {
+      std::cerr << "Warning: --passes only applies when translating in this "
+                << "process, and is ignored.\n";
+    }
 
-    if (is_directory) {
-      code_writer.writeInit();
+    if (write_objects) {
+      for (size_t i = 0; i < vm_name_path_pairs.size(); i++) {
+        std::string vm_path = vm_name_path_pairs[i].second;
+        std::string object_path = constructObjectFile(vm_path);
+        if (fs::exists(object_path) &&
+            fs::last_write_time(object_path) >= fs::last_write_time(vm_path)) {
+          continue;
+        }
+        std::string vm_code = readFile(vm_path);
+        ObjectFile object;
+        TranslateVMObject({vm_name_path_pairs[i].first, vm_code}, &object);
+        std::ofstream object_stream(object_path);
+        WriteObjectFile(object, &object_stream);
+        object_stream.close();
+      }
+      return 0;
+    }
+
+    std::string assembly;
+    std::string symbol_map;
+    if (!socket_path.empty()) {
+      std::vector<std::string> vm_paths;
+      for (size_t i = 0; i < vm_name_path_pairs.size(); i++) {
+        vm_paths.push_back(vm_name_path_pairs[i].second);
+      }
+      std::string error;
+      if (!RequestTranslation(socket_path, vm_paths, is_directory, &assembly,
+                              &symbol_map, &error)) {
+        std::cerr << error << "\n";
+        return 1;
+      }
+      if (is_directory) {
+        writeFile(constructSymbolMapFile(file_path), symbol_map);
+      }
+      writeFile(constructAssemblyFile(file_path), assembly);
+      return 0;
     }
 
+    // The sources only hold views of the VM code, so the code is kept alive
+    // in `vm_codes` until translation is finished.
+    std::vector<std::string> vm_codes;
     for (size_t i = 0; i < vm_name_path_pairs.size(); i++) {
-      parser.openFile(vm_name_path_pairs[i].second);
-      code_writer.setFileName(vm_name_path_pairs[i].first);
-
-      while (parser.hasMoreCommands()) {
-        parser.advance();
-        code_writer.writeCommandComment(parser.getCurrentCommand());
-        if (parser.commandType() == Operation::PUSH ||
-            parser.commandType() == Operation::POP) {
-          code_writer.writePushPop(
-            parser.commandType(), parser.getArg1(), parser.getArg2());
-        } else if (parser.commandType() == Operation::ARITHMETIC) {
-          code_writer.writeArithmetic(parser.getArg1());
-        } else if (parser.commandType() == Operation::LABEL) {
-          code_writer.writeLabel(parser.getArg1());
-        } else if (parser.commandType() == Operation::GOTO) {
-          code_writer.writeGoTo(parser.getArg1());
-        } else if (parser.commandType() == Operation::IF) {
-          code_writer.writeIf(parser.getArg1());
-        } else if (parser.commandType() == Operation::FUNCTION) {
-          code_writer.writeFunction(parser.getArg1(), parser.getArg2());
-        } else if (parser.commandType() == Operation::RETURN) {
-          code_writer.writeReturn();
-        } else if (parser.commandType() == Operation::CALL) {
-          code_writer.writeCall(parser.getArg1(), parser.getArg2());
-        }
+      vm_codes.push_back(readFile(vm_name_path_pairs[i].second));
+    }
+
+    if (pass_manager.hasPasses()) {
+      std::vector<VMModule> modules(vm_codes.size());
+      for (size_t i = 0; i < vm_codes.size(); i++) {
+        ParseVMModule({vm_name_path_pairs[i].first, vm_codes[i]}, &modules[i]);
+      }
+      pass_manager.run(&modules);
+      for (size_t i = 0; i < vm_codes.size(); i++) {
+        vm_codes[i].clear();
+        WriteVMModule(modules[i], &vm_codes[i]);
+      }
+      if (time_passes) {
+        pass_manager.writeTimingReport(&std::cerr);
       }
-      parser.closeFile();
+      if (!dump_after_pass.empty()) {
+        writeFile(constructDumpFile(file_path, dump_after_pass),
+                  pass_manager.getDump());
+      }
+    }
+    std::vector<VMSource> sources;
+    for (size_t i = 0; i < vm_name_path_pairs.size(); i++) {
+      sources.push_back({vm_name_path_pairs[i].first, vm_codes[i]});
+    }
+
+    if (is_directory) {
+      std::string error;
+      if (!TranslateVMProgram(
+            sources, program_options, &assembly, &symbol_map, &error)) {
+        std::cerr << error << "\n";
+        return 1;
+      }
+      writeFile(constructSymbolMapFile(file_path), symbol_map);
+    } else {
+      TranslateVMFile(sources[0], &assembly);
     }
-    code_writer.close();
+    writeFile(constructAssemblyFile(file_path), assembly);
   }
   return 0;
 }
@@ -0,0 +1,261 @@
+#include "object_file.h"
+
+#include <ctype.h>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "hack_encoder.h"
+
+static bool isNumber(std::string_view str) {
+  if (str.empty()) {
+    return false;
+  }
+  for (char curr_char : str) {
+    if (!isdigit(curr_char)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Removes the comment and all whitespace from an assembly line.
+static std::string stripAssemblyLine(std::string_view line) {
+  size_t comment_pos = line.find("//");
+  if (comment_pos != std::string_view::npos) {
+    line = line.substr(0, comment_pos);
+  }
+  std::string stripped;
+  for (char curr_char : line) {
+    if (!isspace(curr_char)) {
+      stripped.push_back(curr_char);
+    }
+  }
+  return stripped;
+}
+
+static char RelocationKindToChar(RelocationKind kind) {
+  switch (kind) {
+    case RelocationKind::LOCAL:
+      return 'L';
+    case RelocationKind::STATIC:
+      return 'S';
+    default:
+      return 'I';
+  }
+}
+
+static bool GetRelocationKindFromChar(char kind_char, RelocationKind* kind) {
+  switch (kind_char) {
+    case 'L':
+      *kind = RelocationKind::LOCAL;
+      return true;
+    case 'S':
+      *kind = RelocationKind::STATIC;
+      return true;
+    case 'I':
+      *kind = RelocationKind::IMPORT;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Reads the section header `<section_name> <count>` into `count`.
+static bool readSectionHeader(std::istream* object_stream,
+                              std::string section_name, int* count) {
+  std::string line;
+  if (!std::getline(*object_stream, line)) {
+    return false;
+  }
+  std::istringstream line_stream(line);
+  std::string name;
+  line_stream >> name >> *count;
+  return (!line_stream.fail() && name.compare(section_name) == 0 &&
+          *count >= 0);
+}
+
+void CreateObjectFile(const TranslatedModule& module, ObjectFile* object) {
+  object->name = module.name;
+  object->n_statics = module.n_statics;
+  object->exports.clear();
+  object->imports.clear();
+  object->relocations.clear();
+  object->code.clear();
+
+  // The first pass removes the labels, recording the instruction each one
+  // refers to.
+  std::unordered_map<std::string, int> labels;
+  std::istringstream assembly_stream(module.assembly);
+  std::string line;
+  while (std::getline(assembly_stream, line)) {
+    std::string instruction = stripAssemblyLine(line);
+    if (instruction.empty()) {
+      continue;
+    }
+    if (instruction[0] == '(') {
+      labels[instruction.substr(1, instruction.size() - 2)] =
+        object->code.size();
+    } else {
+      object->code.push_back(instruction);
+    }
+  }
+
+  // The second pass replaces every symbolic A instruction with a relocation.
+  std::string static_prefix = module.name + ".";
+  std::unordered_map<std::string, int> import_idxs;
+  for (size_t i = 0; i < object->code.size(); i++) {
+    std::string& instruction = object->code[i];
+    if (instruction[0] != '@') {
+      continue;
+    }
+    std::string symbol = instruction.substr(1);
+    if (isNumber(symbol)) {
+      continue;
+    }
+    int address = GetPredefinedSymbolAddress(symbol);
+    if (address >= 0) {
+      instruction = "@" + std::to_string(address);
+      continue;
+    }
+
+    Relocation relocation = {static_cast<int>(i), RelocationKind::LOCAL, 0};
+    auto label_pair = labels.find(symbol);
+    if (label_pair != labels.end()) {
+      relocation.value = label_pair->second;
+    } else if (symbol.compare(0, static_prefix.size(), static_prefix) == 0 &&
+               isNumber(symbol.substr(static_prefix.size()))) {
+      relocation.kind = RelocationKind::STATIC;
+      relocation.value = std::stoi(symbol.substr(static_prefix.size()));
+    } else {
+      relocation.kind = RelocationKind::IMPORT;
+      auto import_pair = import_idxs.find(symbol);
+      if (import_pair == import_idxs.end()) {
+        import_pair = import_idxs.emplace(
+          symbol, static_cast<int>(object->imports.size())).first;
+        object->imports.push_back(symbol);
+      }
+      relocation.value = import_pair->second;
+    }
+    object->relocations.push_back(relocation);
+    instruction = "@";
+  }
+
+  for (size_t i = 0; i < module.functions.size(); i++) {
+    object->exports.push_back(
+      std::make_pair(module.functions[i], labels[module.functions[i]]));
+  }
+}
+
+void TranslateVMObject(const VMSource& source, ObjectFile* object) {
+  TranslatedModule module;
+  TranslateVMModule(source, &module);
+  CreateObjectFile(module, object);
+}
+
+void WriteObjectFile(const ObjectFile& object, std::ostream* object_stream) {
+  (*object_stream) << "vmo 1\n";
+  (*object_stream) << "module " << object.name << " " << object.n_statics
+                   << "\n";
+  (*object_stream) << "exports " << object.exports.size() << "\n";
+  for (size_t i = 0; i < object.exports.size(); i++) {
+    (*object_stream) << object.exports[i].first << " "
+                     << object.exports[i].second << "\n";
+  }
+  (*object_stream) << "imports " << object.imports.size() << "\n";
+  for (size_t i = 0; i < object.imports.size(); i++) {
+    (*object_stream) << object.imports[i] << "\n";
+  }
+  (*object_stream) << "relocations " << object.relocations.size() << "\n";
+  for (size_t i = 0; i < object.relocations.size(); i++) {
+    (*object_stream) << object.relocations[i].instruction_idx << " "
+                     << RelocationKindToChar(object.relocations[i].kind) << " "
+                     << object.relocations[i].value << "\n";
+  }
+  (*object_stream) << "code " << object.code.size() << "\n";
+  for (size_t i = 0; i < object.code.size(); i++) {
+    (*object_stream) << object.code[i] << "\n";
+  }
+}
+
+bool ReadObjectFile(std::istream* object_stream, ObjectFile* object) {
+  std::string line;
+  if (!std::getline(*object_stream, line) || line.compare("vmo 1") != 0) {
+    return false;
+  }
+  if (!std::getline(*object_stream, line)) {
+    return false;
+  }
+  std::istringstream module_stream(line);
+  std::string module_tag;
+  module_stream >> module_tag >> object->name >> object->n_statics;
+  if (module_stream.fail() || module_tag.compare("module") != 0) {
+    return false;
+  }
+
+  int count;
+  object->exports.clear();
+  if (!readSectionHeader(object_stream, "exports", &count)) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    std::string function_name;
+    int instruction_idx;
+    (*object_stream) >> function_name >> instruction_idx;
+    object->exports.push_back(std::make_pair(function_name, instruction_idx));
+  }
+  (*object_stream) >> std::ws;
+
+  object->imports.clear();
+  if (!readSectionHeader(object_stream, "imports", &count)) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    std::string function_name;
+    (*object_stream) >> function_name;
+    object->imports.push_back(function_name);
+  }
+  (*object_stream) >> std::ws;
+
+  object->relocations.clear();
+  if (!readSectionHeader(object_stream, "relocations", &count)) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    Relocation relocation;
+    char kind_char;
+    (*object_stream) >> relocation.instruction_idx >> kind_char
+                     >> relocation.value;
+    if (!GetRelocationKindFromChar(kind_char, &relocation.kind)) {
+      return false;
+    }
+    object->relocations.push_back(relocation);
+  }
+  (*object_stream) >> std::ws;
+
+  object->code.clear();
+  if (!readSectionHeader(object_stream, "code", &count)) {
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    if (!std::getline(*object_stream, line)) {
+      return false;
+    }
+    object->code.push_back(line);
+  }
+
+  // Check that every relocation refers to something in the object.
+  for (size_t i = 0; i < object->relocations.size(); i++) {
+    const Relocation& relocation = object->relocations[i];
+    if (relocation.instruction_idx < 0 ||
+        relocation.instruction_idx >= static_cast<int>(object->code.size())) {
+      return false;
+    }
+    if ((relocation.kind == RelocationKind::IMPORT &&
+         relocation.value >= static_cast<int>(object->imports.size())) ||
+        relocation.value < 0) {
+      return false;
+    }
+  }
+  return !object_stream->bad();
+}
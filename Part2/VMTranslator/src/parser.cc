@@ -1,5 +1,6 @@
 #include "parser.h"
 
+#include <fstream>
 #include <sstream>
 
 Parser::Parser()
@@ -7,27 +8,30 @@ Parser::Parser()
 {}
 
 void Parser::openFile(std::string vm_file) {
-  vm_stream_.open(vm_file);
+  vm_stream_ = std::make_unique<std::ifstream>(vm_file);
+}
+
+void Parser::openBuffer(std::string_view vm_code) {
+  vm_stream_ = std::make_unique<std::istringstream>(std::string(vm_code));
 }
 
 void Parser::closeFile() {
-  vm_stream_.close();
-  vm_stream_.clear();
+  vm_stream_.reset();
 }
 
 bool Parser::hasMoreCommands() {
-  while (!vm_stream_.eof()) {
-    if (isalnum(vm_stream_.peek())) {
+  while (!vm_stream_->eof()) {
+    if (isalnum(vm_stream_->peek())) {
       return true;
     }
     std::string line;
-    std::getline(vm_stream_, line);
+    std::getline(*vm_stream_, line);
   }
   return false;
 }
 
 void Parser::advance() {
-  std::getline(vm_stream_, curr_command_);
+  std::getline(*vm_stream_, curr_command_);
   getCurrCommandComponents();
 }
 
@@ -36,7 +40,8 @@ void Parser::getCurrCommandComponents() {
   std::string vm_op;
   command_stream >> vm_op;
   command_type_ = GetOperationFromString(vm_op);
-  if (command_type_ == Operation::ARITHMETIC) {
+  if (command_type_ == Operation::ARITHMETIC ||
+      command_type_ == Operation::STACK) {
     arg1_ = vm_op;
     return;
   }
@@ -0,0 +1,103 @@
+#include "pass_manager.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+static int countProgramInstructions(const std::vector<VMModule>& modules) {
+  int n_instructions = 0;
+  for (size_t i = 0; i < modules.size(); i++) {
+    n_instructions += CountVMInstructions(modules[i]);
+  }
+  return n_instructions;
+}
+
+bool PassManager::setPipeline(const std::string& pass_names,
+                              std::string* error) {
+  passes_.clear();
+  std::istringstream names_stream(pass_names);
+  std::string pass_name;
+  while (std::getline(names_stream, pass_name, ',')) {
+    if (pass_name.empty()) {
+      continue;
+    }
+    std::unique_ptr<VMPass> pass = CreateVMPass(pass_name);
+    if (pass == nullptr) {
+      *error = "Unknown pass " + pass_name + ". The passes are:";
+      std::vector<std::string> known_names = GetVMPassNames();
+      for (size_t i = 0; i < known_names.size(); i++) {
+        error->append(" " + known_names[i]);
+      }
+      return false;
+    }
+    passes_.push_back(std::move(pass));
+  }
+  return true;
+}
+
+bool PassManager::setDumpAfter(const std::string& pass_name,
+                               std::string* error) {
+  for (size_t i = 0; i < passes_.size(); i++) {
+    if (passes_[i]->getName().compare(pass_name) == 0) {
+      dump_after_ = pass_name;
+      return true;
+    }
+  }
+  *error = "Cannot dump after " + pass_name + " as it is not in the pipeline.";
+  return false;
+}
+
+void PassManager::run(std::vector<VMModule>* modules) {
+  timings_.clear();
+  dump_.clear();
+  for (size_t i = 0; i < passes_.size(); i++) {
+    int n_instructions_before =
+      time_passes_ ? countProgramInstructions(*modules) : 0;
+    auto start_time = std::chrono::steady_clock::now();
+    for (size_t j = 0; j < modules->size(); j++) {
+      passes_[i]->run(&(*modules)[j]);
+    }
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_time;
+    if (time_passes_) {
+      timings_.push_back({passes_[i]->getName(), elapsed.count(),
+                          n_instructions_before,
+                          countProgramInstructions(*modules)});
+    }
+
+    // A pass named more than once is dumped after its last run.
+    if (passes_[i]->getName().compare(dump_after_) == 0) {
+      dump_.clear();
+      for (size_t j = 0; j < modules->size(); j++) {
+        dump_.append("// " + (*modules)[j].name + ".vm after " +
+                     dump_after_ + "\n");
+        WriteVMModule((*modules)[j], &dump_);
+      }
+    }
+  }
+}
+
+void PassManager::writeTimingReport(std::ostream* report_stream) const {
+  (*report_stream) << std::left << std::setw(16) << "pass"
+                   << std::right << std::setw(12) << "time (ms)"
+                   << std::setw(10) << "before" << std::setw(10) << "after"
+                   << std::setw(10) << "change" << "\n";
+  double total_seconds = 0;
+  for (size_t i = 0; i < timings_.size(); i++) {
+    const PassTiming& timing = timings_[i];
+    total_seconds += timing.seconds;
+    (*report_stream) << std::left << std::setw(16) << timing.pass_name
+                     << std::right << std::setw(12) << std::fixed
+                     << std::setprecision(3) << (timing.seconds * 1000)
+                     << std::setw(10) << timing.n_instructions_before
+                     << std::setw(10) << timing.n_instructions_after
+                     << std::setw(10)
+                     << (timing.n_instructions_after -
+                         timing.n_instructions_before)
+                     << "\n";
+  }
+  (*report_stream) << std::left << std::setw(16) << "total"
+                   << std::right << std::setw(12) << std::fixed
+                   << std::setprecision(3) << (total_seconds * 1000) << "\n";
+}
@@ -0,0 +1,44 @@
+#include "static_allocator.h"
+
+// The static segment occupies RAM[16] to RAM[255].
+static const int static_segment_start = 16;
+static const int static_segment_end = 256;
+
+StaticAllocator::StaticAllocator() : next_address_(static_segment_start) {}
+
+int StaticAllocator::allocate(std::string file_name, int n_statics) {
+  int base_address = next_address_;
+  if (base_address + n_statics > static_segment_end) {
+    return -1;
+  }
+  next_address_ += n_statics;
+  allocations_.push_back(std::make_pair(file_name, base_address));
+  base_addresses_[file_name] = base_address;
+  static_counts_[file_name] = n_statics;
+  return base_address;
+}
+
+std::string StaticAllocator::getOverflowError(std::string file_name) {
+  return "The static variables of " + file_name + " overflow the static " +
+         "segment, RAM[" + std::to_string(static_segment_start) + "] to RAM[" +
+         std::to_string(static_segment_end - 1) + "], into the stack.";
+}
+
+int StaticAllocator::getBaseAddress(std::string file_name) {
+  auto itr = base_addresses_.find(file_name);
+  if (itr == base_addresses_.end()) {
+    return -1;
+  }
+  return itr->second;
+}
+
+void StaticAllocator::writeSymbolMap(std::ostream* map_stream) {
+  for (size_t i = 0; i < allocations_.size(); i++) {
+    std::string file_name = allocations_[i].first;
+    int base_address = allocations_[i].second;
+    for (int j = 0; j < static_counts_[file_name]; j++) {
+      (*map_stream) << file_name << "." << j << " " << (base_address + j)
+                    << "\n";
+    }
+  }
+}
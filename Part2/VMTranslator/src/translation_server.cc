@@ -0,0 +1,432 @@
+#include "translation_server.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Once the cache holds this many modules it is cleared, so that a long running
+// server translating many distinct programs does not grow without bound.
+static const size_t max_cached_modules = 4096;
+
+// The most sources a request may have, well above the number of files of any
+// program, so that a malformed header is rejected before anything is read.
+static const int max_request_sources = 1024;
+
+// The most accepted connections waiting for a worker. Once the queue is full,
+// further connections wait in the listen backlog.
+static const size_t max_pending_connections = 64;
+
+// Provides buffered reads of lines and raw bytes from a socket.
+class SocketReader {
+public:
+  SocketReader(int fd) : fd_(fd), pos_(0) {}
+
+  // reads up to the next newline into `line`, discarding the newline.
+  bool readLine(std::string* line) {
+    while (true) {
+      size_t newline_pos = buffer_.find('\n', pos_);
+      if (newline_pos != std::string::npos) {
+        line->assign(buffer_, pos_, newline_pos - pos_);
+        pos_ = newline_pos + 1;
+        return true;
+      }
+      if (!fill()) {
+        return false;
+      }
+    }
+  }
+
+  // reads exactly `n_bytes` bytes into `bytes`.
+  bool readBytes(size_t n_bytes, std::string* bytes) {
+    while (buffer_.size() - pos_ < n_bytes) {
+      if (!fill()) {
+        return false;
+      }
+    }
+    bytes->assign(buffer_, pos_, n_bytes);
+    pos_ += n_bytes;
+    return true;
+  }
+
+private:
+  // reads more data from the socket, discarding data that was already read.
+  bool fill() {
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+    char chunk[4096];
+    ssize_t n_read = read(fd_, chunk, sizeof(chunk));
+    if (n_read <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, n_read);
+    return true;
+  }
+
+  int fd_;
+  std::string buffer_;
+  size_t pos_;
+};
+
+static bool writeAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t n_written = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n_written <= 0) {
+      return false;
+    }
+    data.remove_prefix(n_written);
+  }
+  return true;
+}
+
+static bool sendError(int fd, std::string message) {
+  std::stringstream ss;
+  ss << "error " << message.size() << "\n" << message;
+  return writeAll(fd, ss.str());
+}
+
+// Reads the file `file_path` into `contents`. Returns false if the file
+// cannot be read.
+static bool readFile(std::string file_path, std::string* contents) {
+  std::ifstream file_stream(file_path);
+  if (!file_stream.is_open()) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << file_stream.rdbuf();
+  if (file_stream.bad()) {
+    return false;
+  }
+  *contents = ss.str();
+  return true;
+}
+
+static bool connectToSocket(std::string socket_path, int* fd) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  socket_path.copy(address.sun_path, socket_path.size());
+  *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (*fd < 0) {
+    return false;
+  }
+  if (connect(*fd, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    close(*fd);
+    return false;
+  }
+  return true;
+}
+
+TranslationServer::TranslationServer(std::string socket_path)
+  : socket_path_(socket_path), listen_fd_(-1) {}
+
+TranslationServer::~TranslationServer() {
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+  }
+}
+
+bool TranslationServer::serve() {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path " << socket_path_ << " is too long.\n";
+    return false;
+  }
+  socket_path_.copy(address.sun_path, socket_path_.size());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    std::cerr << "Could not create socket " << socket_path_ << ".\n";
+    return false;
+  }
+  // remove the socket left behind by a previous server.
+  unlink(socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) < 0 ||
+      listen(listen_fd_, SOMAXCONN) < 0) {
+    std::cerr << "Could not listen on socket " << socket_path_ << ".\n";
+    return false;
+  }
+
+  // The workers run until the process is killed. If fewer threads can be
+  // started than wanted, the server runs with those it has.
+  int n_workers =
+    std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  int n_started = 0;
+  for (int i = 0; i < n_workers; i++) {
+    try {
+      std::thread(&TranslationServer::runWorker, this).detach();
+      n_started++;
+    } catch (const std::system_error&) {
+      break;
+    }
+  }
+  if (n_started == 0) {
+    std::cerr << "Could not start any translation workers.\n";
+    return false;
+  }
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+      queue_changed_.wait(queue_lock, [this]() {
+        return pending_fds_.size() < max_pending_connections;
+      });
+    }
+    int connection_fd = accept(listen_fd_, nullptr, nullptr);
+    if (connection_fd < 0) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+      pending_fds_.push_back(connection_fd);
+    }
+    queue_changed_.notify_all();
+  }
+  return true;
+}
+
+void TranslationServer::runWorker() {
+  while (true) {
+    int connection_fd;
+    {
+      std::unique_lock<std::mutex> queue_lock(queue_mutex_);
+      queue_changed_.wait(queue_lock, [this]() {
+        return !pending_fds_.empty();
+      });
+      connection_fd = pending_fds_.front();
+      pending_fds_.pop_front();
+    }
+    queue_changed_.notify_all();
+    handleConnection(connection_fd);
+  }
+}
+
+void TranslationServer::handleConnection(int connection_fd) {
+  try {
+    serveRequests(connection_fd);
+  } catch (const std::exception& e) {
+    sendError(connection_fd, std::string("Translation failed: ") + e.what());
+  }
+  close(connection_fd);
+}
+
+void TranslationServer::serveRequests(int connection_fd) {
+  SocketReader reader(connection_fd);
+  std::string header;
+  while (reader.readLine(&header)) {
+    std::istringstream header_stream(header);
+    std::string command;
+    std::string mode;
+    int n_sources = 0;
+    header_stream >> command >> mode >> n_sources;
+    bool is_program = (mode.compare("program") == 0);
+    if (command.compare("translate") != 0 ||
+        (!is_program && mode.compare("file") != 0) ||
+        n_sources < 1 || (!is_program && n_sources != 1)) {
+      sendError(connection_fd, "Malformed request: " + header);
+      break;
+    }
+    if (n_sources > max_request_sources) {
+      sendError(connection_fd, "Too many sources for request: " + header);
+      break;
+    }
+
+    // The sources only hold views of the VM code, so the code is kept alive
+    // in `vm_codes` until translation is finished. Each source is added as
+    // it is read, so nothing is reserved for sources that never arrive.
+    std::vector<std::string> names;
+    std::vector<std::string> vm_codes;
+    bool valid_sources = true;
+    // the first path that could not be read. The remaining sources are still
+    // read, so that the next request starts where it should.
+    std::string unreadable_path;
+    for (int i = 0; (i < n_sources) && valid_sources; i++) {
+      std::string source_line;
+      if (!reader.readLine(&source_line)) {
+        valid_sources = false;
+        break;
+      }
+      std::istringstream source_stream(source_line);
+      std::string source_kind;
+      source_stream >> source_kind;
+      names.emplace_back();
+      vm_codes.emplace_back();
+      if (source_kind.compare("buffer") == 0) {
+        size_t n_bytes = 0;
+        source_stream >> names[i] >> n_bytes;
+        valid_sources = (!names[i].empty() &&
+                         reader.readBytes(n_bytes, &vm_codes[i]));
+      } else if (source_kind.compare("path") == 0) {
+        // skip the space after `path`, then take the rest of the line.
+        std::string vm_path;
+        source_stream.ignore(1);
+        std::getline(source_stream, vm_path);
+        names[i] = fs::path(vm_path).stem().string();
+        if (!readFile(vm_path, &vm_codes[i]) && unreadable_path.empty()) {
+          unreadable_path = vm_path;
+        }
+      } else {
+        valid_sources = false;
+      }
+    }
+    if (!valid_sources) {
+      sendError(connection_fd, "Malformed sources for request: " + header);
+      break;
+    }
+    if (!unreadable_path.empty()) {
+      if (!sendError(connection_fd, "Could not read " + unreadable_path)) {
+        break;
+      }
+      continue;
+    }
+
+    std::vector<VMSource> sources;
+    for (int i = 0; i < n_sources; i++) {
+      sources.push_back({names[i], vm_codes[i]});
+    }
+    std::string assembly;
+    std::string symbol_map;
+    std::string error;
+    if (!translate(sources, is_program, &assembly, &symbol_map, &error)) {
+      if (!sendError(connection_fd, error)) {
+        break;
+      }
+      continue;
+    }
+
+    std::stringstream response_header;
+    response_header << "ok " << assembly.size() << " " << symbol_map.size()
+                    << "\n";
+    if (!writeAll(connection_fd, response_header.str()) ||
+        !writeAll(connection_fd, assembly) ||
+        !writeAll(connection_fd, symbol_map)) {
+      break;
+    }
+  }
+}
+
+bool TranslationServer::translate(const std::vector<VMSource>& sources,
+                                  bool is_program,
+                                  std::string* assembly,
+                                  std::string* symbol_map,
+                                  std::string* error) {
+  if (!is_program) {
+    // a single file translates to exactly the code of its module.
+    assembly->append(getTranslatedModule(sources[0])->assembly);
+    return true;
+  }
+
+  // Link the modules in the same order as `TranslateVMProgram` so that both
+  // produce the same program.
+  std::vector<VMSource> sorted_sources = sources;
+  std::sort(sorted_sources.begin(), sorted_sources.end(),
+            [](const VMSource& lhs, const VMSource& rhs) {
+              return lhs.name < rhs.name;
+            });
+
+  // The shared pointers keep the modules alive even if the cache is cleared
+  // by another connection while this program is being linked.
+  std::vector<std::shared_ptr<const TranslatedModule>> cached_modules;
+  std::vector<const TranslatedModule*> modules;
+  for (size_t i = 0; i < sorted_sources.size(); i++) {
+    cached_modules.push_back(getTranslatedModule(sorted_sources[i]));
+    modules.push_back(cached_modules.back().get());
+  }
+  return LinkVMModules(modules, assembly, symbol_map, error);
+}
+
+std::shared_ptr<const TranslatedModule> TranslationServer::getTranslatedModule(
+  const VMSource& source) {
+  std::string cache_key = source.name;
+  cache_key.push_back('\n');
+  cache_key.append(source.code);
+  {
+    std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+    auto itr = module_cache_.find(cache_key);
+    if (itr != module_cache_.end()) {
+      return itr->second;
+    }
+  }
+
+  // Translate outside of the lock so that other connections are not blocked.
+  // If two connections translate the same module at once, the translations
+  // are identical and either one is kept.
+  auto module = std::make_shared<TranslatedModule>();
+  TranslateVMModule(source, module.get());
+
+  std::lock_guard<std::mutex> cache_lock(cache_mutex_);
+  if (module_cache_.size() >= max_cached_modules) {
+    module_cache_.clear();
+  }
+  module_cache_[cache_key] = module;
+  return module;
+}
+
+bool RequestTranslation(std::string socket_path,
+                        const std::vector<std::string>& vm_paths,
+                        bool is_program,
+                        std::string* assembly,
+                        std::string* symbol_map,
+                        std::string* error) {
+  int fd;
+  if (!connectToSocket(socket_path, &fd)) {
+    *error = "Could not connect to translation server at " + socket_path;
+    return false;
+  }
+
+  // The server resolves paths from its own working directory, so send
+  // absolute paths.
+  std::stringstream request;
+  request << "translate " << (is_program ? "program" : "file") << " "
+          << vm_paths.size() << "\n";
+  for (size_t i = 0; i < vm_paths.size(); i++) {
+    request << "path " << fs::absolute(vm_paths[i]).string() << "\n";
+  }
+
+  SocketReader reader(fd);
+  std::string response_header;
+  if (!writeAll(fd, request.str()) || !reader.readLine(&response_header)) {
+    *error = "Translation server closed the connection.";
+    close(fd);
+    return false;
+  }
+
+  std::istringstream header_stream(response_header);
+  std::string status;
+  header_stream >> status;
+  bool succeeded = false;
+  if (status.compare("ok") == 0) {
+    size_t n_assembly_bytes = 0;
+    size_t n_map_bytes = 0;
+    header_stream >> n_assembly_bytes >> n_map_bytes;
+    succeeded = (reader.readBytes(n_assembly_bytes, assembly) &&
+                 reader.readBytes(n_map_bytes, symbol_map));
+    if (!succeeded) {
+      *error = "Translation server sent an incomplete response.";
+    }
+  } else {
+    size_t n_bytes = 0;
+    header_stream >> n_bytes;
+    if (!reader.readBytes(n_bytes, error)) {
+      *error = "Translation server sent an incomplete response.";
+    }
+  }
+  close(fd);
+  return succeeded;
+}
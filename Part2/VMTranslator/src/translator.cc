@@ -2,8 +2,79 @@
 
 #include <sstream>
 
+// The temp segment occupies RAM[5] to RAM[12].
+static const int temp_segment_start = 5;
+
+// The largest offsets into a segment addressed by incrementing A once per
+// offset. Up to these offsets the increments are no longer than adding the
+// offset through D, and popping this way avoids parking the address in D.
+static const int max_push_chain_offset = 2;
+static const int max_pop_chain_offset = 3;
+
+// The number of words moved by each pass through the unrolled loops of the
+// bulk memory intrinsics. A power of two, so the words left over are found
+// with a mask.
+static const int intrinsic_unroll_factor = 16;
+
+// The slots of a static frame, in order, are the return address, the saved
+// THIS and THAT, the arguments and the local variables.
+static int getSavedThisAddress(const FrameLayout& frame_layout) {
+  return frame_layout.static_frame_address + 1;
+}
+
+static int getSavedThatAddress(const FrameLayout& frame_layout) {
+  return getSavedThisAddress(frame_layout) + (frame_layout.saves_this ? 1 : 0);
+}
+
+static int getStaticArgumentAddress(const FrameLayout& frame_layout, int i) {
+  return getSavedThatAddress(frame_layout) +
+    (frame_layout.saves_that ? 1 : 0) + i;
+}
+
+static int getStaticLocalAddress(const FrameLayout& frame_layout, int i) {
+  return getStaticArgumentAddress(frame_layout, frame_layout.n_args) + i;
+}
+
+// The jump testing D = x - y that is taken when the comparison `operation` of
+// x and y is true.
+static std::string getComparisonJump(const std::string& operation) {
+  if (operation.compare("eq") == 0) {
+    return "JEQ";
+  } else if (operation.compare("ne") == 0) {
+    return "JNE";
+  } else if (operation.compare("lt") == 0) {
+    return "JLT";
+  } else if (operation.compare("ge") == 0) {
+    return "JGE";
+  } else if (operation.compare("gt") == 0) {
+    return "JGT";
+  }
+  return "JLE";
+}
+
+// The jump taken exactly when `jump` is not.
+static std::string getNegatedJump(const std::string& jump) {
+  if (jump.compare("JEQ") == 0) {
+    return "JNE";
+  } else if (jump.compare("JNE") == 0) {
+    return "JEQ";
+  } else if (jump.compare("JLT") == 0) {
+    return "JGE";
+  } else if (jump.compare("JGE") == 0) {
+    return "JLT";
+  } else if (jump.compare("JGT") == 0) {
+    return "JLE";
+  }
+  return "JGT";
+}
+
 Translator::Translator()
-  : label_idx_(0),  static_segment_(""), curr_function_(""), func_calls_(0) {}
+  : label_idx_(0),
+    static_segment_(""),
+    curr_function_(""),
+    func_calls_(0),
+    frame_layouts_(nullptr),
+    curr_frame_layout_(getFrameLayout("")) {}
 
 std::string Translator::translateInitOperation() {
   refreshOutputStream();
@@ -16,7 +87,17 @@ std::string Translator::translateInitOperation() {
   out_stream_ << "@SP\n";
   out_stream_ << "M=D\n";
 
-  saveCurrStateAndJumpToFunction("Sys.init", 0);
+  callFunction("Sys.init", 0);
+
+  // Sys.init should never return, but if it does the program halts here
+  // rather than running on into the code that follows.
+  out_stream_ << "(";
+  addReturnAddress();
+  out_stream_ << ")\n";
+  out_stream_ << "@";
+  addReturnAddress();
+  out_stream_ << "\n";
+  out_stream_ << "0;JMP\n";
 
   return out_stream_.str();
 }
@@ -50,6 +131,15 @@ std::string Translator::translateArithmeticOperation(std::string operation) {
   } else if (operation.compare("gt") == 0) {
     // D = x - y, jump if D > 0
     translateComparison("D;JGT");
+  } else if (operation.compare("ne") == 0) {
+    // D = x - y, jump if D != 0
+    translateComparison("D;JNE");
+  } else if (operation.compare("ge") == 0) {
+    // D = x - y, jump if D >= 0
+    translateComparison("D;JGE");
+  } else if (operation.compare("le") == 0) {
+    // D = x - y, jump if D <= 0
+    translateComparison("D;JLE");
   } else {
     return "";
   }
@@ -58,7 +148,11 @@ std::string Translator::translateArithmeticOperation(std::string operation) {
 
 std::string Translator::translatePushOperation(std::string segment, int i) {
   refreshOutputStream();
-  if (segment.compare("constant") == 0) {
+  int static_frame_address = getStaticFrameAddress(segment, i);
+  if (static_frame_address >= 0) {
+    out_stream_ << "@" << static_frame_address << "\n";
+    pushValueInRegisterM();
+  } else if (segment.compare("constant") == 0) {
     pushConstant(i);
   } else if (segment.compare("local") == 0) {
     out_stream_ << "@LCL\n";
@@ -73,10 +167,9 @@ std::string Translator::translatePushOperation(std::string segment, int i) {
     out_stream_ << "@THAT\n";
     pushSegment(i);
   } else if (segment.compare("temp") == 0) {
-    out_stream_ << "@5\n";
     pushTemp(i);
   } else if (segment.compare("static") == 0) {
-    out_stream_ << "@" << static_segment_ << "." << i << "\n";
+    atStaticCommand(i);
     pushValueInRegisterM();
   } else if (segment.compare("pointer") == 0) {
     setAddressFromPointer(i);
@@ -89,20 +182,20 @@ std::string Translator::translatePushOperation(std::string segment, int i) {
 
 std::string Translator::translatePopOperation(std::string segment, int i) {
   refreshOutputStream();
-  if (segment.compare("local") == 0) {
-    out_stream_ << "@LCL\n";
-    popSegment(i);
+  int static_frame_address = getStaticFrameAddress(segment, i);
+  if (static_frame_address >= 0) {
+    decrementStackPointerAndAssignToD();
+    out_stream_ << "@" << static_frame_address << "\n";
+    out_stream_ << "M=D\n";
+  } else if (segment.compare("local") == 0) {
+    popSegment("LCL", i);
   } else if (segment.compare("argument") == 0) {
-    out_stream_ << "@ARG\n";
-    popSegment(i);
+    popSegment("ARG", i);
   } else if (segment.compare("this") == 0) {
-    out_stream_ << "@THIS\n";
-    popSegment(i);
+    popSegment("THIS", i);
   } else if (segment.compare("that") == 0) {
-    out_stream_ << "@THAT\n";
-    popSegment(i);
+    popSegment("THAT", i);
   } else if (segment.compare("temp") == 0) {
-    out_stream_ << "@5\n";
     popTemp(i);
   } else if (segment.compare("static") == 0) {
     popStatic(i);
@@ -135,6 +228,51 @@ std::string Translator::translateIfGoToOperation(std::string label_str) {
   return out_stream_.str();
 }
 
+std::string Translator::translateGoToIndexedOperation(
+  std::string label_str, int n_labels) {
+  refreshOutputStream();
+  decrementStackPointerAndAssignToD();
+  jumpToIntrinsicLabel("TABLE_END", "D;JLT");
+  out_stream_ << "@" << n_labels << "\n";
+  out_stream_ << "D=D-A\n";
+  jumpToIntrinsicLabel("TABLE_END", "D;JGE");
+
+  // D = i - n_labels, and each entry of the table is two instructions, so
+  // the entry for index i is 2 * (n_labels - i) before the end of the table.
+  out_stream_ << "A=D\n";
+  out_stream_ << "D=D+A\n";
+  out_stream_ << "@";
+  addIntrinsicLabelString("TABLE_END");
+  out_stream_ << "\n";
+  out_stream_ << "A=D+A\n";
+  out_stream_ << "0;JMP\n";
+  for (int i = 0; i < n_labels; i++) {
+    atLabelCommand(label_str + "_" + std::to_string(i));
+    out_stream_ << "0;JMP\n";
+  }
+  createIntrinsicLabel("TABLE_END");
+
+  label_idx_++;
+  return out_stream_.str();
+}
+
+std::string Translator::translateComparisonIfGoToOperation(
+  std::string operation, bool is_negated, std::string label_str) {
+  refreshOutputStream();
+  // D = x - y, popping both values.
+  decrementStackPointerAndAssignToD();
+  out_stream_ << "A=A-1\n";
+  out_stream_ << "D=M-D\n";
+  stackPointerDecrementInstruction();
+
+  // jump straight to the label on the outcome of the comparison, rather
+  // than pushing the boolean for the `if-goto` to pop.
+  std::string jump = getComparisonJump(operation);
+  atLabelCommand(label_str);
+  out_stream_ << "D;" << (is_negated ? getNegatedJump(jump) : jump) << "\n";
+  return out_stream_.str();
+}
+
 std::string Translator::translateFunctionOperation(
   std::string function_name, int n_vars) {
   // clearing state when entering function
@@ -146,16 +284,65 @@ std::string Translator::translateFunctionOperation(
   createLabel(function_name);
 
   curr_function_ = function_name;
+  curr_frame_layout_ = getFrameLayout(function_name);
 
+  if (curr_frame_layout_.static_frame_address < 0) {
+    for (int i = 0; i < n_vars; i++) {
+      pushConstant(0);
+    }
+    return out_stream_.str();
+  }
+
+  // the caller passes the return address in D.
+  out_stream_ << "@" << curr_frame_layout_.static_frame_address << "\n";
+  out_stream_ << "M=D\n";
+  if (curr_frame_layout_.saves_this) {
+    out_stream_ << "@THIS\n";
+    out_stream_ << "D=M\n";
+    out_stream_ << "@" << getSavedThisAddress(curr_frame_layout_) << "\n";
+    out_stream_ << "M=D\n";
+  }
+  if (curr_frame_layout_.saves_that) {
+    out_stream_ << "@THAT\n";
+    out_stream_ << "D=M\n";
+    out_stream_ << "@" << getSavedThatAddress(curr_frame_layout_) << "\n";
+    out_stream_ << "M=D\n";
+  }
   for (int i = 0; i < n_vars; i++) {
-    pushConstant(0);
+    out_stream_ << "@" << getStaticLocalAddress(curr_frame_layout_, i) << "\n";
+    out_stream_ << "M=0\n";
   }
 
   return out_stream_.str();
 }
 
-std::string Translator::translateReturnOperation() {
+std::string Translator::translateReturnOperation(bool returns_value) {
   refreshOutputStream();
+  FrameLayout frame_layout = curr_frame_layout_;
+  if (frame_layout.static_frame_address >= 0) {
+    // The function's stack is balanced, so its return value, if it has one,
+    // is already on top of the stack where the caller expects it.
+    if (frame_layout.saves_that) {
+      out_stream_ << "@" << getSavedThatAddress(frame_layout) << "\n";
+      out_stream_ << "D=M\n";
+      out_stream_ << "@THAT\n";
+      out_stream_ << "M=D\n";
+    }
+    if (frame_layout.saves_this) {
+      out_stream_ << "@" << getSavedThisAddress(frame_layout) << "\n";
+      out_stream_ << "D=M\n";
+      out_stream_ << "@THIS\n";
+      out_stream_ << "M=D\n";
+    }
+    out_stream_ << "@" << frame_layout.static_frame_address << "\n";
+    out_stream_ << "A=M\n";
+    out_stream_ << "0;JMP\n";
+    return out_stream_.str();
+  }
+
+  // the return address, LCL, ARG and the saved pointers.
+  int frame_size = 3 + (frame_layout.saves_this ? 1 : 0) +
+    (frame_layout.saves_that ? 1 : 0);
 
   // D = *LCL
   out_stream_ << "@LCL\n";
@@ -165,8 +352,8 @@ std::string Translator::translateReturnOperation() {
   out_stream_ << "@R13\n";
   out_stream_ << "M=D\n";
 
-  // D = *R13 - 5
-  out_stream_ << "@5\n";
+  // D = *R13 - frame_size
+  out_stream_ << "@" << frame_size << "\n";
   out_stream_ << "A=D-A\n";
   out_stream_ << "D=M\n";
 
@@ -174,32 +361,29 @@ std::string Translator::translateReturnOperation() {
   out_stream_ << "@R14\n";
   out_stream_ << "M=D\n";
 
-  // RAM[*ARG] = pop()
-  out_stream_ << "@ARG\n";
-  out_stream_ << "D=M\n";
-  addOffsetAndPopFromStack(/*offset=*/0);
+  if (returns_value) {
+    // RAM[*ARG] = pop()
+    popSegment("ARG", 0);
+  }
 
   // D = *ARG
   out_stream_ << "@ARG\n";
   out_stream_ << "D=M\n";
 
-  // *SP = D + 1 (*SP = *ARG + 1 because D = *ARG)
+  // *SP = D + 1 (*SP = *ARG + 1 because D = *ARG), or just past the caller's
+  // stack without the arguments if there is no return value.
   out_stream_ << "@SP\n";
-  out_stream_ << "M=D+1\n";
+  out_stream_ << (returns_value ? "M=D+1\n" : "M=D\n");
 
-  // *THAT = *R13 - 1 (R13 stores endFrame). Update R13 to store endFrame - 1.
-  decrementRegisterAndAssignToSegment("R13", "THAT");
-
-  // *THIS = *R13 - 1 (R13 stores endFrame - 1).
-  // Update R13 to store endFrame - 2.
-  decrementRegisterAndAssignToSegment("R13", "THIS");
-
-  // *ARG = *R13 - 1 (R13 stores endFrame - 2).
-  // Update R13 to store endFrame - 3.
+  // Restore the saved registers in the reverse order they were pushed, with
+  // R13 stepping down from endFrame.
+  if (frame_layout.saves_that) {
+    decrementRegisterAndAssignToSegment("R13", "THAT");
+  }
+  if (frame_layout.saves_this) {
+    decrementRegisterAndAssignToSegment("R13", "THIS");
+  }
   decrementRegisterAndAssignToSegment("R13", "ARG");
-
-  // *LCL = *R13 - 1 (R13 stores endFrame - 3).
-  // Update R13 to store endFrame - 4.
   decrementRegisterAndAssignToSegment("R13", "LCL");
 
   // goto *R14 (R14 stores retAddr)
@@ -211,10 +395,21 @@ std::string Translator::translateReturnOperation() {
 }
 
 std::string Translator::translateCallOperation(
-  std::string function_name, int n_args) {
+  std::string function_name, int n_args, bool returns_value) {
   refreshOutputStream();
 
-  saveCurrStateAndJumpToFunction(function_name, n_args);
+  // The bulk memory functions of the OS are expanded in place, leaving the
+  // same stack as the call would.
+  if (n_args == 3 && function_name.compare("Memory.fill") == 0) {
+    inlineMemoryFill(returns_value);
+    return out_stream_.str();
+  }
+  if (n_args == 3 && function_name.compare("Memory.copy") == 0) {
+    inlineMemoryCopy(returns_value);
+    return out_stream_.str();
+  }
+
+  callFunction(function_name, n_args);
 
   // (returnAddress)
   out_stream_ << "(";
@@ -225,6 +420,46 @@ std::string Translator::translateCallOperation(
   return out_stream_.str();
 }
 
+std::string Translator::translateIncDecOperation(
+  bool is_increment, std::string segment, int i) {
+  refreshOutputStream();
+  if (!addressSegmentSlot(segment, i)) {
+    return "";
+  }
+  out_stream_ << (is_increment ? "M=M+1\n" : "M=M-1\n");
+  return out_stream_.str();
+}
+
+std::string Translator::translateStackOperation(std::string operation) {
+  refreshOutputStream();
+  if (operation.compare("load") == 0) {
+    // *(SP-1) = RAM[*(SP-1)]
+    out_stream_ << "@SP\n";
+    out_stream_ << "A=M-1\n";
+    out_stream_ << "A=M\n";
+    out_stream_ << "D=M\n";
+    out_stream_ << "@SP\n";
+    out_stream_ << "A=M-1\n";
+    out_stream_ << "M=D\n";
+  } else if (operation.compare("store") == 0) {
+    // D = pop() is the value, then RAM[pop()] = D
+    decrementStackPointerAndAssignToD();
+    decrementStackPointerAndAssignToA();
+    out_stream_ << "A=M\n";
+    out_stream_ << "M=D\n";
+  } else if (operation.compare("dup") == 0) {
+    // push(*(SP-1))
+    out_stream_ << "@SP\n";
+    out_stream_ << "A=M-1\n";
+    pushValueInRegisterM();
+  } else if (operation.compare("drop") == 0) {
+    stackPointerDecrementInstruction();
+  } else {
+    return "";
+  }
+  return out_stream_.str();
+}
+
 /* *****************
  * PRIVATE MEMBERS
  * ****************/
@@ -272,7 +507,9 @@ void Translator::translateComparison(std::string comparison_expression) {
 
   // if D = x - y and we already put true in the stack position.
   // So if the comparison evaluates to true jump to cleanup
-  out_stream_ << "@CLEANUP" << label_idx_ << "\n";
+  out_stream_ << "@";
+  addCleanupLabelString();
+  out_stream_ << "\n";
   out_stream_ << comparison_expression << "\n";
 
   // otherwise, flip true to false in the stack position
@@ -282,7 +519,9 @@ void Translator::translateComparison(std::string comparison_expression) {
   out_stream_ << "M=M+1\n";
 
   // SP--;
-  out_stream_ << "(CLEANUP" << label_idx_ << ")\n";
+  out_stream_ << "(";
+  addCleanupLabelString();
+  out_stream_ << ")\n";
   stackPointerDecrementInstruction();
 
   label_idx_++;
@@ -296,6 +535,13 @@ void Translator::pushConstant(int i) {
 }
 
 void Translator::pushSegment(int i) {
+  if (i <= max_push_chain_offset) {
+    // A = RAM[@segment] + i (A already points to @segment)
+    addSegmentOffsetChain(i);
+    pushValueInRegisterM();
+    return;
+  }
+
   // D = RAM[@segment] (A already points to @segment)
   out_stream_ << "D=M\n";
 
@@ -303,10 +549,9 @@ void Translator::pushSegment(int i) {
 }
 
 void Translator::pushTemp(int i) {
-  // D = 5 (A = @temp, that is A = 5)
-  out_stream_ << "D=A\n";
-
-  addOffsetAndPushToStack(/*offset=*/i);
+  // the temp segment is at a fixed address, so `temp i` is addressed directly.
+  out_stream_ << "@" << (temp_segment_start + i) << "\n";
+  pushValueInRegisterM();
 }
 
 void Translator::addOffsetAndPushToStack(int offset) {
@@ -317,28 +562,55 @@ void Translator::addOffsetAndPushToStack(int offset) {
   pushValueInRegisterM();
 }
 
-void Translator::popSegment(int i) {
-  // D = RAM[@segment] (A already has the value @segment)
+void Translator::popSegment(std::string segment_name, int i) {
+  if (i <= max_pop_chain_offset) {
+    decrementStackPointerAndAssignToD();
+
+    // RAM[RAM[@segment] + i] = D
+    out_stream_ << "@" << segment_name << "\n";
+    addSegmentOffsetChain(i);
+    out_stream_ << "M=D\n";
+    return;
+  }
+
+  // D = RAM[@segment]
+  out_stream_ << "@" << segment_name << "\n";
   out_stream_ << "D=M\n";
 
   addOffsetAndPopFromStack(/*offset=*/i);
 }
 
 void Translator::popTemp(int i) {
-  // D = 5 (A already stores 5, the start of the temp segment)
-  out_stream_ << "D=A\n";
+  decrementStackPointerAndAssignToD();
 
-  addOffsetAndPopFromStack(/*offset=*/i);
+  // the temp segment is at a fixed address, so `temp i` is addressed directly.
+  out_stream_ << "@" << (temp_segment_start + i) << "\n";
+  out_stream_ << "M=D\n";
+}
+
+void Translator::addSegmentOffsetChain(int offset) {
+  if (offset == 0) {
+    out_stream_ << "A=M\n";
+    return;
+  }
+  out_stream_ << "A=M+1\n";
+  for (int i = 1; i < offset; i++) {
+    out_stream_ << "A=A+1\n";
+  }
 }
 
 void Translator::popStatic(int i) {
   decrementStackPointerAndAssignToD();
 
   // @Foo.i = D where `Foo` is the name of the static segment
-  out_stream_ << "@" << static_segment_ << "." << i << "\n";
+  atStaticCommand(i);
   out_stream_ << "M=D\n";
 }
 
+void Translator::atStaticCommand(int i) {
+  out_stream_ << "@" << static_segment_ << "." << i << "\n";
+}
+
 void Translator::popPointer(int i) {
   decrementStackPointerAndAssignToD();
 
@@ -365,6 +637,42 @@ void Translator::addOffsetAndPopFromStack(int offset) {
   out_stream_ << "M=D-A\n";
 }
 
+bool Translator::addressSegmentSlot(std::string segment, int i) {
+  int static_frame_address = getStaticFrameAddress(segment, i);
+  std::string segment_register = "";
+  if (segment.compare("local") == 0) {
+    segment_register = "LCL";
+  } else if (segment.compare("argument") == 0) {
+    segment_register = "ARG";
+  } else if (segment.compare("this") == 0) {
+    segment_register = "THIS";
+  } else if (segment.compare("that") == 0) {
+    segment_register = "THAT";
+  }
+
+  if (static_frame_address >= 0) {
+    out_stream_ << "@" << static_frame_address << "\n";
+  } else if (!segment_register.empty()) {
+    out_stream_ << "@" << segment_register << "\n";
+    if (i <= max_push_chain_offset) {
+      addSegmentOffsetChain(i);
+    } else {
+      out_stream_ << "D=M\n";
+      out_stream_ << "@" << i << "\n";
+      out_stream_ << "A=D+A\n";
+    }
+  } else if (segment.compare("temp") == 0) {
+    out_stream_ << "@" << (temp_segment_start + i) << "\n";
+  } else if (segment.compare("static") == 0) {
+    atStaticCommand(i);
+  } else if (segment.compare("pointer") == 0) {
+    setAddressFromPointer(i);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 void Translator::refreshOutputStream() {
   out_stream_.clear();
   out_stream_.str(std::string());
@@ -426,6 +734,208 @@ void Translator::addLabelString(std::string label_str) {
   out_stream_ << label_str;
 }
 
+void Translator::addCleanupLabelString() {
+  out_stream_ << static_segment_ << "$CLEANUP" << label_idx_;
+}
+
+void Translator::addIntrinsicLabelString(std::string label_str) {
+  out_stream_ << static_segment_ << "$" << label_str << label_idx_;
+}
+
+void Translator::createIntrinsicLabel(std::string label_str) {
+  out_stream_ << "(";
+  addIntrinsicLabelString(label_str);
+  out_stream_ << ")\n";
+}
+
+void Translator::jumpToIntrinsicLabel(std::string label_str,
+                                      std::string jump_expression) {
+  out_stream_ << "@";
+  addIntrinsicLabelString(label_str);
+  out_stream_ << "\n";
+  out_stream_ << jump_expression << "\n";
+}
+
+void Translator::popOrReplaceWithZero(bool replace_with_zero) {
+  // D = *(SP-1), then either SP-- or *(SP-1) = 0.
+  out_stream_ << "@SP\n";
+  out_stream_ << (replace_with_zero ? "A=M-1\n" : "AM=M-1\n");
+  out_stream_ << "D=M\n";
+  if (replace_with_zero) {
+    out_stream_ << "M=0\n";
+  }
+}
+
+void Translator::inlineMemoryFill(bool returns_value) {
+  // R15 = value, R14 = len, R13 = addr, and the return value 0 replaces addr
+  // if there is one.
+  out_stream_ << "@SP\n";
+  out_stream_ << "AM=M-1\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R15\n";
+  out_stream_ << "M=D\n";
+  out_stream_ << "@SP\n";
+  out_stream_ << "AM=M-1\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=D\n";
+  popOrReplaceWithZero(returns_value);
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=D\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "D=M\n";
+  jumpToIntrinsicLabel("FILL_END", "D;JLE");
+
+  // fills one word at a time until the words left are a multiple of the
+  // unroll factor.
+  createIntrinsicLabel("FILL_REM");
+  out_stream_ << "@R14\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@" << (intrinsic_unroll_factor - 1) << "\n";
+  out_stream_ << "D=D&A\n";
+  jumpToIntrinsicLabel("FILL_BLOCKS", "D;JEQ");
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=M+1\n";
+  out_stream_ << "A=M-1\n";
+  out_stream_ << "M=D\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=M-1\n";
+  jumpToIntrinsicLabel("FILL_REM", "0;JMP");
+
+  // R14 = the address just past the last word, then each pass holds the
+  // value in D and walks A over the next block.
+  createIntrinsicLabel("FILL_BLOCKS");
+  out_stream_ << "@R14\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "D=D+M\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=D\n";
+  createIntrinsicLabel("FILL_LOOP");
+  out_stream_ << "@R13\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "D=M-D\n";
+  jumpToIntrinsicLabel("FILL_END", "D;JLE");
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "A=M\n";
+  for (int i = 0; i < intrinsic_unroll_factor; i++) {
+    out_stream_ << "M=D\n";
+    out_stream_ << "A=A+1\n";
+  }
+  out_stream_ << "D=A\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=D\n";
+  jumpToIntrinsicLabel("FILL_LOOP", "0;JMP");
+  createIntrinsicLabel("FILL_END");
+
+  label_idx_++;
+}
+
+void Translator::inlineMemoryCopy(bool returns_value) {
+  // R15 = len, R13 = src, R14 = dst, and the return value 0 replaces dst if
+  // there is one.
+  out_stream_ << "@SP\n";
+  out_stream_ << "AM=M-1\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R15\n";
+  out_stream_ << "M=D\n";
+  out_stream_ << "@SP\n";
+  out_stream_ << "AM=M-1\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=D\n";
+  popOrReplaceWithZero(returns_value);
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=D\n";
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  jumpToIntrinsicLabel("COPY_END", "D;JLE");
+
+  // a destination above the source is copied from the last word down, so
+  // that overlapping words are read before they are overwritten.
+  out_stream_ << "@R14\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "D=D-M\n";
+  jumpToIntrinsicLabel("COPY_DOWN", "D;JGT");
+
+  // the pointers sit one word before the next word to copy.
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=M-1\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=M-1\n";
+  addCopyLoops("COPY_UP", true);
+  jumpToIntrinsicLabel("COPY_END", "0;JMP");
+
+  // the pointers sit one word past the next word to copy.
+  createIntrinsicLabel("COPY_DOWN");
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << "M=D+M\n";
+  out_stream_ << "@R14\n";
+  out_stream_ << "M=D+M\n";
+  addCopyLoops("COPY_DOWN", false);
+  createIntrinsicLabel("COPY_END");
+
+  label_idx_++;
+}
+
+void Translator::addCopyLoops(std::string label_prefix, bool is_upwards) {
+  std::string step_expression = is_upwards ? "AM=M+1\n" : "AM=M-1\n";
+  auto copy_word = [&]() {
+    out_stream_ << "@R13\n";
+    out_stream_ << step_expression;
+    out_stream_ << "D=M\n";
+    out_stream_ << "@R14\n";
+    out_stream_ << step_expression;
+    out_stream_ << "M=D\n";
+  };
+
+  // copies one word at a time until the words left are a multiple of the
+  // unroll factor.
+  createIntrinsicLabel(label_prefix + "_REM");
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@" << (intrinsic_unroll_factor - 1) << "\n";
+  out_stream_ << "D=D&A\n";
+  jumpToIntrinsicLabel(label_prefix + "_BLOCKS", "D;JEQ");
+  copy_word();
+  out_stream_ << "@R15\n";
+  out_stream_ << "M=M-1\n";
+  jumpToIntrinsicLabel(label_prefix + "_REM", "0;JMP");
+
+  // R15 = the source address the source pointer stops at.
+  createIntrinsicLabel(label_prefix + "_BLOCKS");
+  out_stream_ << "@R15\n";
+  out_stream_ << "D=M\n";
+  out_stream_ << "@R13\n";
+  out_stream_ << (is_upwards ? "D=D+M\n" : "D=M-D\n");
+  out_stream_ << "@R15\n";
+  out_stream_ << "M=D\n";
+  createIntrinsicLabel(label_prefix + "_LOOP");
+  if (is_upwards) {
+    out_stream_ << "@R13\n";
+    out_stream_ << "D=M\n";
+    out_stream_ << "@R15\n";
+  } else {
+    out_stream_ << "@R15\n";
+    out_stream_ << "D=M\n";
+    out_stream_ << "@R13\n";
+  }
+  out_stream_ << "D=M-D\n";
+  jumpToIntrinsicLabel("COPY_END", "D;JLE");
+  for (int i = 0; i < intrinsic_unroll_factor; i++) {
+    copy_word();
+  }
+  jumpToIntrinsicLabel(label_prefix + "_LOOP", "0;JMP");
+}
+
 void Translator::addReturnAddress() {
   out_stream_ << curr_function_;
   if (curr_function_.compare("") != 0)
@@ -467,13 +977,19 @@ void Translator::saveCurrStateAndJumpToFunction(
   out_stream_ << "@ARG\n";
   pushValueInRegisterM();
 
-  // push THIS
-  out_stream_ << "@THIS\n";
-  pushValueInRegisterM();
-
-  // push THAT
-  out_stream_ << "@THAT\n";
-  pushValueInRegisterM();
+  // push THIS and THAT, unless the function can never change them.
+  FrameLayout frame_layout = getFrameLayout(function_name);
+  int frame_size = 3;
+  if (frame_layout.saves_this) {
+    out_stream_ << "@THIS\n";
+    pushValueInRegisterM();
+    frame_size++;
+  }
+  if (frame_layout.saves_that) {
+    out_stream_ << "@THAT\n";
+    pushValueInRegisterM();
+    frame_size++;
+  }
 
   // D = *SP
   out_stream_ << "@SP\n";
@@ -483,11 +999,11 @@ void Translator::saveCurrStateAndJumpToFunction(
   out_stream_ << "@LCL\n";
   out_stream_ << "M=D\n";
 
-  // D = D - (5 + n_args) (D = *SP - 5 - n_args as D = *SP)
-  out_stream_ << "@" << (5 + n_args) << "\n";
+  // D = D - (frame_size + n_args) (D = *SP - frame_size - n_args as D = *SP)
+  out_stream_ << "@" << (frame_size + n_args) << "\n";
   out_stream_ << "D=D-A\n";
 
-  // *ARG = D (*ARG = *SP - 5 - n_args as D = *SP - 5 - n_args)
+  // *ARG = D (*ARG = *SP - frame_size - n_args)
   out_stream_ << "@ARG\n";
   out_stream_ << "M=D\n";
 
@@ -495,3 +1011,56 @@ void Translator::saveCurrStateAndJumpToFunction(
   out_stream_ << "@" << function_name << "\n";
   out_stream_ << "0;JMP\n";
 }
+
+void Translator::jumpToStaticFrameFunction(
+  std::string function_name, int n_args) {
+  FrameLayout frame_layout = getFrameLayout(function_name);
+  // the last argument is on top of the stack.
+  for (int i = n_args - 1; i >= 0; i--) {
+    decrementStackPointerAndAssignToD();
+    out_stream_ << "@" << getStaticArgumentAddress(frame_layout, i) << "\n";
+    out_stream_ << "M=D\n";
+  }
+
+  // D = returnAddress
+  out_stream_ << "@";
+  addReturnAddress();
+  out_stream_ << "\n";
+  out_stream_ << "D=A\n";
+
+  // goto function_name
+  out_stream_ << "@" << function_name << "\n";
+  out_stream_ << "0;JMP\n";
+}
+
+void Translator::callFunction(std::string function_name, int n_args) {
+  if (getFrameLayout(function_name).static_frame_address >= 0) {
+    jumpToStaticFrameFunction(function_name, n_args);
+  } else {
+    saveCurrStateAndJumpToFunction(function_name, n_args);
+  }
+}
+
+int Translator::getStaticFrameAddress(std::string segment, int i) {
+  if (curr_frame_layout_.static_frame_address < 0) {
+    return -1;
+  }
+  if (segment.compare("argument") == 0) {
+    return getStaticArgumentAddress(curr_frame_layout_, i);
+  }
+  if (segment.compare("local") == 0) {
+    return getStaticLocalAddress(curr_frame_layout_, i);
+  }
+  return -1;
+}
+
+FrameLayout Translator::getFrameLayout(const std::string& function_name) {
+  if (frame_layouts_ != nullptr) {
+    auto itr = frame_layouts_->find(function_name);
+    if (itr != frame_layouts_->end()) {
+      return itr->second;
+    }
+  }
+  return {/*saves_this=*/true, /*saves_that=*/true,
+          /*static_frame_address=*/-1, /*n_args=*/0};
+}
@@ -0,0 +1,87 @@
+#include "vm_module.h"
+
+#include <sstream>
+
+#include "parser.h"
+
+// The keyword starting a command of type `command_type`, for the operations
+// whose keyword is not held in `arg1`.
+static std::string getCommandKeyword(Operation command_type) {
+  switch (command_type) {
+    case Operation::PUSH:
+      return "push";
+    case Operation::POP:
+      return "pop";
+    case Operation::LABEL:
+      return "label";
+    case Operation::GOTO:
+      return "goto";
+    case Operation::IF:
+      return "if-goto";
+    case Operation::GOTO_INDEXED:
+      return "goto-indexed";
+    case Operation::FUNCTION:
+      return "function";
+    case Operation::CALL:
+      return "call";
+    case Operation::RETURN:
+      return "return";
+    case Operation::CALL_VOID:
+      return "call-void";
+    case Operation::RETURN_VOID:
+      return "return-void";
+    case Operation::INC:
+      return "inc";
+    case Operation::DEC:
+      return "dec";
+    default:
+      return "";
+  }
+}
+
+void ParseVMModule(const VMSource& source, VMModule* module) {
+  module->name = source.name;
+  module->commands.clear();
+  Parser parser;
+  parser.openBuffer(source.code);
+  while (parser.hasMoreCommands()) {
+    parser.advance();
+    if (parser.commandType() == Operation::UNKNOWN) {
+      continue;
+    }
+    module->commands.push_back(
+      {parser.commandType(), parser.getArg1(), parser.getArg2()});
+  }
+  parser.closeFile();
+}
+
+void WriteVMModule(const VMModule& module, std::string* vm_code) {
+  std::ostringstream vm_stream;
+  for (size_t i = 0; i < module.commands.size(); i++) {
+    const VMCommand& command = module.commands[i];
+    if (command.command_type == Operation::ARITHMETIC ||
+        command.command_type == Operation::STACK) {
+      vm_stream << command.arg1 << "\n";
+      continue;
+    }
+    vm_stream << getCommandKeyword(command.command_type);
+    if (!IsOperationWithNoArguments(command.command_type)) {
+      vm_stream << " " << command.arg1;
+    }
+    if (IsOperationWithTwoArguments(command.command_type)) {
+      vm_stream << " " << command.arg2;
+    }
+    vm_stream << "\n";
+  }
+  vm_code->append(vm_stream.str());
+}
+
+int CountVMInstructions(const VMModule& module) {
+  int n_instructions = 0;
+  for (size_t i = 0; i < module.commands.size(); i++) {
+    if (module.commands[i].command_type != Operation::LABEL) {
+      n_instructions++;
+    }
+  }
+  return n_instructions;
+}
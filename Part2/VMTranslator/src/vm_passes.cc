@@ -0,0 +1,210 @@
+#include "vm_passes.h"
+
+// The largest value of `push constant i`.
+static const int max_constant = 32767;
+
+static bool isPushConstant(const VMCommand& command) {
+  return command.command_type == Operation::PUSH &&
+    command.arg1.compare("constant") == 0;
+}
+
+static bool isArithmetic(const VMCommand& command, const std::string& op) {
+  return command.command_type == Operation::ARITHMETIC &&
+    command.arg1.compare(op) == 0;
+}
+
+// Removes the commands that can never run: those after a `goto` or `return`
+// and before the next label or function. Then removes each `goto` that only
+// jumps over labels, since control reaches its target anyway.
+class DeadCodePass : public VMPass {
+public:
+  std::string getName() const override { return "dead-code"; }
+
+  void run(VMModule* module) override {
+    std::vector<VMCommand> live_commands;
+    bool is_reachable = true;
+    for (size_t i = 0; i < module->commands.size(); i++) {
+      const VMCommand& command = module->commands[i];
+      if (command.command_type == Operation::LABEL ||
+          command.command_type == Operation::FUNCTION) {
+        is_reachable = true;
+      }
+      if (!is_reachable) {
+        continue;
+      }
+      live_commands.push_back(command);
+      if (command.command_type == Operation::GOTO ||
+          command.command_type == Operation::RETURN ||
+          command.command_type == Operation::RETURN_VOID) {
+        is_reachable = false;
+      }
+    }
+
+    module->commands.clear();
+    for (size_t i = 0; i < live_commands.size(); i++) {
+      if (live_commands[i].command_type == Operation::GOTO &&
+          jumpsOverLabels(live_commands, i)) {
+        continue;
+      }
+      module->commands.push_back(live_commands[i]);
+    }
+  }
+
+private:
+  // determines if the target of the `goto` at `goto_idx` is one of the labels
+  // directly after it.
+  static bool jumpsOverLabels(const std::vector<VMCommand>& commands,
+                              size_t goto_idx) {
+    for (size_t i = goto_idx + 1; i < commands.size() &&
+           commands[i].command_type == Operation::LABEL; i++) {
+      if (commands[i].arg1.compare(commands[goto_idx].arg1) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Evaluates arithmetic on constants, such as `push constant 2`,
+// `push constant 3`, `add`, replacing it with the pushed result when that
+// result can be pushed. Also removes adding, subtracting or or-ing with 0 and
+// two `not`s or `neg`s in a row.
+class ConstantFoldingPass : public VMPass {
+public:
+  std::string getName() const override { return "fold-constants"; }
+
+  void run(VMModule* module) override {
+    std::vector<VMCommand> folded_commands;
+    for (size_t i = 0; i < module->commands.size(); i++) {
+      const VMCommand& command = module->commands[i];
+      if (command.command_type != Operation::ARITHMETIC ||
+          !fold(command.arg1, &folded_commands)) {
+        folded_commands.push_back(command);
+      }
+    }
+    module->commands = folded_commands;
+  }
+
+private:
+  // folds the arithmetic command `op` into the end of `commands`, the
+  // commands before it. Returns false if it could not be folded.
+  static bool fold(const std::string& op, std::vector<VMCommand>* commands) {
+    size_t n_commands = commands->size();
+    bool is_unary = (op.compare("neg") == 0 || op.compare("not") == 0);
+    if (is_unary) {
+      if (n_commands >= 1 && isArithmetic(commands->back(), op)) {
+        commands->pop_back();
+        return true;
+      }
+      if (n_commands >= 1 && isPushConstant(commands->back()) &&
+          commands->back().arg2 == 0 && op.compare("neg") == 0) {
+        return true;
+      }
+      return false;
+    }
+
+    if (n_commands < 1 || !isPushConstant(commands->back())) {
+      return false;
+    }
+    int rhs = commands->back().arg2;
+    if (n_commands < 2 || !isPushConstant((*commands)[n_commands - 2])) {
+      if (rhs == 0 && (op.compare("add") == 0 || op.compare("sub") == 0 ||
+                       op.compare("or") == 0)) {
+        commands->pop_back();
+        return true;
+      }
+      return false;
+    }
+
+    int lhs = (*commands)[n_commands - 2].arg2;
+    bool is_comparison = false;
+    int result = 0;
+    if (op.compare("add") == 0) {
+      result = lhs + rhs;
+    } else if (op.compare("sub") == 0) {
+      result = lhs - rhs;
+    } else if (op.compare("and") == 0) {
+      result = lhs & rhs;
+    } else if (op.compare("or") == 0) {
+      result = lhs | rhs;
+    } else if (op.compare("eq") == 0) {
+      is_comparison = true;
+      result = (lhs == rhs);
+    } else if (op.compare("gt") == 0) {
+      is_comparison = true;
+      result = (lhs > rhs);
+    } else if (op.compare("lt") == 0) {
+      is_comparison = true;
+      result = (lhs < rhs);
+    } else if (op.compare("ne") == 0) {
+      is_comparison = true;
+      result = (lhs != rhs);
+    } else if (op.compare("ge") == 0) {
+      is_comparison = true;
+      result = (lhs >= rhs);
+    } else if (op.compare("le") == 0) {
+      is_comparison = true;
+      result = (lhs <= rhs);
+    } else {
+      return false;
+    }
+    if (!is_comparison && (result < 0 || result > max_constant)) {
+      return false;
+    }
+
+    commands->pop_back();
+    commands->back().arg2 = is_comparison ? 0 : result;
+    // true is -1, which can only be pushed as `not 0`.
+    if (is_comparison && result) {
+      commands->push_back({Operation::ARITHMETIC, "not", -1});
+    }
+    return true;
+  }
+};
+
+// Replaces `push s i`, `push constant 1`, `add`, `pop s i` with `inc s i`,
+// and the same with `sub` with `dec s i`.
+class IncDecPass : public VMPass {
+public:
+  std::string getName() const override { return "inc-dec"; }
+
+  void run(VMModule* module) override {
+    std::vector<VMCommand> rewritten_commands;
+    const std::vector<VMCommand>& commands = module->commands;
+    for (size_t i = 0; i < commands.size(); i++) {
+      if (i + 3 < commands.size() &&
+          commands[i].command_type == Operation::PUSH &&
+          commands[i].arg1.compare("constant") != 0 &&
+          isPushConstant(commands[i + 1]) && commands[i + 1].arg2 == 1 &&
+          (isArithmetic(commands[i + 2], "add") ||
+           isArithmetic(commands[i + 2], "sub")) &&
+          commands[i + 3].command_type == Operation::POP &&
+          commands[i + 3].arg1.compare(commands[i].arg1) == 0 &&
+          commands[i + 3].arg2 == commands[i].arg2) {
+        rewritten_commands.push_back(
+          {isArithmetic(commands[i + 2], "add") ? Operation::INC
+                                                : Operation::DEC,
+           commands[i].arg1, commands[i].arg2});
+        i += 3;
+        continue;
+      }
+      rewritten_commands.push_back(commands[i]);
+    }
+    module->commands = rewritten_commands;
+  }
+};
+
+std::vector<std::string> GetVMPassNames() {
+  return {"dead-code", "fold-constants", "inc-dec"};
+}
+
+std::unique_ptr<VMPass> CreateVMPass(const std::string& pass_name) {
+  if (pass_name.compare("dead-code") == 0) {
+    return std::make_unique<DeadCodePass>();
+  } else if (pass_name.compare("fold-constants") == 0) {
+    return std::make_unique<ConstantFoldingPass>();
+  } else if (pass_name.compare("inc-dec") == 0) {
+    return std::make_unique<IncDecPass>();
+  }
+  return nullptr;
+}
@@ -0,0 +1,332 @@
+#include "vm_translator.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <sstream>
+#include <unordered_map>
+
+#include "call_graph.h"
+#include "code_writer.h"
+#include "operation.h"
+#include "parser.h"
+#include "static_allocator.h"
+#include "translator.h"
+
+// Records the number of static variables used by the VM code `vm_code` in
+// `module`, which is one more than the largest `i` in a `push static i` or
+// `pop static i`, along with the names of the functions it defines.
+static void scanModule(
+  Parser* parser, std::string_view vm_code, TranslatedModule* module) {
+  module->n_statics = 0;
+  module->functions.clear();
+  parser->openBuffer(vm_code);
+  while (parser->hasMoreCommands()) {
+    parser->advance();
+    if ((parser->commandType() == Operation::PUSH ||
+         parser->commandType() == Operation::POP ||
+         parser->commandType() == Operation::INC ||
+         parser->commandType() == Operation::DEC) &&
+        parser->getArg1().compare("static") == 0) {
+      module->n_statics = std::max(module->n_statics, parser->getArg2() + 1);
+    } else if (parser->commandType() == Operation::FUNCTION) {
+      module->functions.push_back(parser->getArg1());
+    }
+  }
+  parser->closeFile();
+}
+
+// Writes every command remaining in `parser` using `code_writer`.
+static void writeParsedCommands(Parser* parser, CodeWriter* code_writer) {
+  while (parser->hasMoreCommands()) {
+    parser->advance();
+    code_writer->writeCommandComment(parser->getCurrentCommand());
+    if (parser->commandType() == Operation::PUSH ||
+        parser->commandType() == Operation::POP) {
+      code_writer->writePushPop(
+        parser->commandType(), parser->getArg1(), parser->getArg2());
+    } else if (parser->commandType() == Operation::ARITHMETIC) {
+      code_writer->writeArithmetic(parser->getArg1());
+    } else if (parser->commandType() == Operation::LABEL) {
+      code_writer->writeLabel(parser->getArg1());
+    } else if (parser->commandType() == Operation::GOTO) {
+      code_writer->writeGoTo(parser->getArg1());
+    } else if (parser->commandType() == Operation::IF) {
+      code_writer->writeIf(parser->getArg1());
+    } else if (parser->commandType() == Operation::GOTO_INDEXED) {
+      code_writer->writeGoToIndexed(parser->getArg1(), parser->getArg2());
+    } else if (parser->commandType() == Operation::FUNCTION) {
+      code_writer->writeFunction(parser->getArg1(), parser->getArg2());
+    } else if (parser->commandType() == Operation::RETURN ||
+               parser->commandType() == Operation::RETURN_VOID) {
+      code_writer->writeReturn(
+        parser->commandType() == Operation::RETURN);
+    } else if (parser->commandType() == Operation::CALL ||
+               parser->commandType() == Operation::CALL_VOID) {
+      code_writer->writeCall(parser->getArg1(), parser->getArg2(),
+                             parser->commandType() == Operation::CALL);
+    } else if (parser->commandType() == Operation::INC ||
+               parser->commandType() == Operation::DEC) {
+      code_writer->writeIncDec(
+        parser->commandType(), parser->getArg1(), parser->getArg2());
+    } else if (parser->commandType() == Operation::STACK) {
+      code_writer->writeStackOperation(parser->getArg1());
+    }
+  }
+}
+
+// If `line` is the A instruction `@name.i` addressing a static variable of the
+// module `name`, returns `i`. Otherwise, returns -1.
+static int getStaticIndex(std::string_view line, const std::string& name) {
+  size_t prefix_size = name.size() + 2;
+  if (line.size() <= prefix_size || line[0] != '@' ||
+      line.compare(1, name.size(), name) != 0 ||
+      line[name.size() + 1] != '.') {
+    return -1;
+  }
+  int static_idx = 0;
+  for (size_t i = prefix_size; i < line.size(); i++) {
+    if (!isdigit(line[i])) {
+      return -1;
+    }
+    static_idx = (static_idx * 10) + (line[i] - '0');
+  }
+  return static_idx;
+}
+
+// Appends the assembly of `module` to `assembly_stream`, replacing each
+// `@name.i` static symbol with the address `static_base_address + i`.
+static void writeRelocatedModule(const TranslatedModule& module,
+                                 int static_base_address,
+                                 std::ostream* assembly_stream) {
+  std::string_view assembly = module.assembly;
+  size_t line_start = 0;
+  while (line_start < assembly.size()) {
+    size_t line_end = assembly.find('\n', line_start);
+    if (line_end == std::string_view::npos) {
+      line_end = assembly.size();
+    }
+    std::string_view line = assembly.substr(line_start, line_end - line_start);
+    int static_idx = getStaticIndex(line, module.name);
+    if (static_idx < 0) {
+      (*assembly_stream) << line << "\n";
+    } else {
+      (*assembly_stream) << "@" << (static_base_address + static_idx) << "\n";
+    }
+    line_start = line_end + 1;
+  }
+}
+
+// Static frames share the static segment with the static variables, and must
+// end below the stack.
+static const int static_frame_region_end = 256;
+
+// Gives each function of `sources` that can never be called again before it
+// returns a static frame in RAM from `static_frame_region_start`. Functions
+// that may be active at the same time get disjoint frames, while functions
+// that never are, such as two leaf functions, share the same addresses.
+// Functions whose frame does not fit keep their frame on the stack.
+static void allocateStaticFrames(
+  const CallGraph& call_graph,
+  int static_frame_region_start,
+  std::unordered_map<std::string, FrameLayout>* frame_layouts) {
+  // the first address that is free for each function's frame, which is past
+  // the frames of every function that may call it.
+  std::unordered_map<std::string, int> frame_starts;
+  std::vector<std::vector<std::string>> call_order = call_graph.getCallOrder();
+  for (size_t i = 0; i < call_order.size(); i++) {
+    const std::vector<std::string>& group = call_order[i];
+    int frame_start = static_frame_region_start;
+    for (size_t j = 0; j < group.size(); j++) {
+      auto itr = frame_starts.find(group[j]);
+      if (itr != frame_starts.end()) {
+        frame_start = std::max(frame_start, itr->second);
+      }
+    }
+
+    int frame_end = frame_start;
+    std::string function_name = group[0];
+    if (!call_graph.isRecursive(function_name) &&
+        call_graph.hasBalancedStack(function_name)) {
+      FrameLayout* frame_layout = &(*frame_layouts)[function_name];
+      int frame_size = 1 + (frame_layout->saves_this ? 1 : 0) +
+        (frame_layout->saves_that ? 1 : 0) + frame_layout->n_args +
+        call_graph.getNVars(function_name);
+      if (frame_start + frame_size <= static_frame_region_end) {
+        frame_layout->static_frame_address = frame_start;
+        frame_end = frame_start + frame_size;
+      }
+    }
+
+    for (size_t j = 0; j < group.size(); j++) {
+      std::vector<std::string> callees = call_graph.getCallees(group[j]);
+      for (size_t k = 0; k < callees.size(); k++) {
+        auto itr = frame_starts.find(callees[k]);
+        if (itr == frame_starts.end()) {
+          frame_starts[callees[k]] = frame_end;
+        } else {
+          itr->second = std::max(itr->second, frame_end);
+        }
+      }
+    }
+  }
+}
+
+// Finds the frame layout of every function in `sources` for the frame
+// conventions enabled by `options`. Static frames are allocated from
+// `static_frame_region_start`.
+static void computeFrameLayouts(
+  const std::vector<VMSource>& sources,
+  const ProgramOptions& options,
+  int static_frame_region_start,
+  std::unordered_map<std::string, FrameLayout>* frame_layouts) {
+  Parser parser;
+  CallGraph call_graph;
+  for (size_t i = 0; i < sources.size(); i++) {
+    call_graph.addModule(&parser, sources[i].code);
+  }
+  call_graph.analyse();
+
+  // With lean frames a call saves a pointer only if the callee may change it.
+  std::vector<std::string> function_names = call_graph.getFunctionNames();
+  for (size_t i = 0; i < function_names.size(); i++) {
+    (*frame_layouts)[function_names[i]] = {
+      !options.lean_frames || call_graph.mayWritePointer(function_names[i], 0),
+      !options.lean_frames || call_graph.mayWritePointer(function_names[i], 1),
+      /*static_frame_address=*/-1,
+      call_graph.getNArgs(function_names[i])};
+  }
+
+  if (options.static_frames) {
+    allocateStaticFrames(
+      call_graph, static_frame_region_start, frame_layouts);
+  }
+}
+
+// Translates `source`, appending the assembly code to `assembly`. Calls and
+// returns use `frame_layouts`, which may be null.
+static void translateSource(
+  const VMSource& source,
+  const std::unordered_map<std::string, FrameLayout>* frame_layouts,
+  std::string* assembly) {
+  std::ostringstream assembly_stream;
+  CodeWriter code_writer(&assembly_stream);
+  Parser parser;
+
+  parser.openBuffer(source.code);
+  code_writer.setFileName(source.name);
+  code_writer.setFrameLayouts(frame_layouts);
+  writeParsedCommands(&parser, &code_writer);
+  parser.closeFile();
+
+  code_writer.close();
+  assembly->append(assembly_stream.str());
+}
+
+// Translates `source` into `module`, with calls and returns using
+// `frame_layouts`, which may be null.
+static void translateModule(
+  const VMSource& source,
+  const std::unordered_map<std::string, FrameLayout>* frame_layouts,
+  TranslatedModule* module) {
+  Parser parser;
+  module->name = source.name;
+  scanModule(&parser, source.code, module);
+  module->assembly.clear();
+  translateSource(source, frame_layouts, &module->assembly);
+}
+
+// Links `modules` as in `LinkVMModules`, with the bootstrap call to Sys.init
+// using `frame_layouts`, which may be null.
+static bool linkModules(
+  const std::vector<const TranslatedModule*>& modules,
+  const std::unordered_map<std::string, FrameLayout>* frame_layouts,
+  std::string* assembly,
+  std::string* symbol_map,
+  std::string* error) {
+  // The whole program is known, so statics are given fixed addresses rather
+  // than being left for the assembler to discover.
+  StaticAllocator static_allocator;
+  for (size_t i = 0; i < modules.size(); i++) {
+    if (static_allocator.allocate(
+          modules[i]->name, modules[i]->n_statics) < 0) {
+      *error = StaticAllocator::getOverflowError(modules[i]->name);
+      return false;
+    }
+  }
+  if (symbol_map != nullptr) {
+    std::ostringstream map_stream;
+    static_allocator.writeSymbolMap(&map_stream);
+    symbol_map->append(map_stream.str());
+  }
+
+  std::ostringstream assembly_stream;
+  Translator translator;
+  translator.setFrameLayouts(frame_layouts);
+  assembly_stream << translator.translateInitOperation();
+  for (size_t i = 0; i < modules.size(); i++) {
+    writeRelocatedModule(
+      *modules[i],
+      static_allocator.getBaseAddress(modules[i]->name),
+      &assembly_stream);
+  }
+  assembly->append(assembly_stream.str());
+  return true;
+}
+
+void TranslateVMFile(const VMSource& source, std::string* assembly) {
+  translateSource(source, /*frame_layouts=*/nullptr, assembly);
+}
+
+void TranslateVMModule(const VMSource& source, TranslatedModule* module) {
+  translateModule(source, /*frame_layouts=*/nullptr, module);
+}
+
+bool LinkVMModules(const std::vector<const TranslatedModule*>& modules,
+                   std::string* assembly,
+                   std::string* symbol_map,
+                   std::string* error) {
+  return linkModules(
+    modules, /*frame_layouts=*/nullptr, assembly, symbol_map, error);
+}
+
+bool TranslateVMProgram(std::vector<VMSource> sources,
+                        const ProgramOptions& options,
+                        std::string* assembly,
+                        std::string* symbol_map,
+                        std::string* error) {
+  // Translate the files in a fixed order so that the static layout and the
+  // generated code do not depend on the order the sources were given in.
+  std::sort(sources.begin(), sources.end(),
+            [](const VMSource& lhs, const VMSource& rhs) {
+              return lhs.name < rhs.name;
+            });
+
+  std::unordered_map<std::string, FrameLayout> program_frame_layouts;
+  const std::unordered_map<std::string, FrameLayout>* frame_layouts = nullptr;
+  if (options.lean_frames || options.static_frames) {
+    // The static frames go after the static variables, which are allocated
+    // the same way when the modules are linked.
+    StaticAllocator static_allocator;
+    Parser parser;
+    TranslatedModule scanned_module;
+    for (size_t i = 0; i < sources.size(); i++) {
+      scanModule(&parser, sources[i].code, &scanned_module);
+      if (static_allocator.allocate(
+            sources[i].name, scanned_module.n_statics) < 0) {
+        *error = StaticAllocator::getOverflowError(sources[i].name);
+        return false;
+      }
+    }
+    computeFrameLayouts(sources, options, static_allocator.getNextAddress(),
+                        &program_frame_layouts);
+    frame_layouts = &program_frame_layouts;
+  }
+
+  std::vector<TranslatedModule> translated_modules(sources.size());
+  std::vector<const TranslatedModule*> modules;
+  for (size_t i = 0; i < sources.size(); i++) {
+    translateModule(sources[i], frame_layouts, &translated_modules[i]);
+    modules.push_back(&translated_modules[i]);
+  }
+  return linkModules(modules, frame_layouts, assembly, symbol_map, error);
+}
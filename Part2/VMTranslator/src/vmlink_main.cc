@@ -0,0 +1,70 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "linker.h"
+#include "object_file.h"
+
+namespace fs = std::filesystem;
+
+// Usage:
+//   vmlink <output.asm | output.hack> <object.vmo | directory>...
+// Links the objects, and every object found in the given directories, into a
+// single program. The addresses of the static variables are written to
+// `output.map`.
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: vmlink <output.asm | output.hack> "
+              << "<object.vmo | directory>...\n";
+    return 1;
+  }
+  fs::path output_path = ((std::string)argv[1]);
+  bool binary = (output_path.extension().compare(".hack") == 0);
+
+  std::vector<std::string> object_paths;
+  std::string ext = ".vmo";
+  for (int i = 2; i < argc; i++) {
+    fs::path input_path = ((std::string)argv[i]);
+    if (fs::is_directory(input_path)) {
+      for (auto const &p : fs::recursive_directory_iterator(input_path)) {
+        if (p.path().extension().compare(ext) == 0) {
+          object_paths.push_back(p.path().string());
+        }
+      }
+    } else {
+      object_paths.push_back(input_path.string());
+    }
+  }
+
+  Linker linker;
+  for (size_t i = 0; i < object_paths.size(); i++) {
+    std::ifstream object_stream(object_paths[i]);
+    ObjectFile object;
+    if (!ReadObjectFile(&object_stream, &object)) {
+      std::cerr << object_paths[i] << " is not a valid object file.\n";
+      return 1;
+    }
+    linker.addObject(std::move(object));
+  }
+
+  std::string program;
+  std::string symbol_map;
+  std::string error;
+  if (!linker.link(binary, &program, &symbol_map, &error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+
+  std::ofstream program_stream(output_path);
+  program_stream << program;
+  program_stream.close();
+
+  fs::path map_path = output_path;
+  map_path.replace_extension(".map");
+  std::ofstream map_stream(map_path);
+  map_stream << symbol_map;
+  map_stream.close();
+  return 0;
+}